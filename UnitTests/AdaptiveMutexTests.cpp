@@ -0,0 +1,137 @@
+#include "crazygaze/core/AdaptiveMutex.h"
+#include "crazygaze/core/ThreadingUtils.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+// Busy loop, to simulate a critical section that takes a while without the thread blocking
+void busyWork(int iterations)
+{
+	volatile int dummy = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		dummy = dummy + 1;
+	}
+}
+
+template<typename Lock>
+void benchmark(const char* name, int numThreads, int iterations, int workInside)
+{
+	Lock lock;
+	uint64_t counter = 0;
+	float ms = measureTimeMs([&]()
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < numThreads; t++)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int i = 0; i < iterations; i++)
+				{
+					std::lock_guard lk(lock);
+					busyWork(workInside);
+					counter++;
+				}
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+	});
+
+	CHECK(counter == uint64_t(numThreads) * iterations);
+	std::println("{:>16}: {:8.2f} ns per lock/unlock", name, ms * 1000000.0f / float(numThreads * iterations));
+}
+
+} // anonymous namespace
+
+TEST_CASE("AdaptiveMutex", "[AdaptiveMutex]")
+{
+	SECTION("try_lock")
+	{
+		AdaptiveMutex mtx;
+		CHECK(mtx.try_lock());
+		CHECK(mtx.try_lock() == false);
+		std::thread([&]()
+		{
+			CHECK(mtx.try_lock() == false);
+		}).join();
+		mtx.unlock();
+		CHECK(mtx.try_lock());
+		mtx.unlock();
+	}
+
+	SECTION("blocks when held for long")
+	{
+		AdaptiveMutex mtx;
+		mtx.lock();
+		uint32_t estimate = mtx.getSpinEstimate();
+
+		std::atomic<bool> acquired = false;
+		std::thread other([&]()
+		{
+			std::lock_guard lk(mtx);
+			acquired = true;
+		});
+
+		// Long enough for the other thread to give up spinning and block
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		CHECK(acquired == false);
+		mtx.unlock();
+		other.join();
+		CHECK(acquired);
+
+		// Spinning didn't pay off, so it should spin less next time
+		CHECK(mtx.getSpinEstimate() < estimate);
+	}
+
+	SECTION("contention")
+	{
+		Monitor<std::vector<int>, AdaptiveMutex> monitor;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (int i = 0; i < 5000; i++)
+				{
+					monitor([&](std::vector<int>& v)
+					{
+						v.push_back(i);
+						// Make some of the critical sections long, so that some threads block
+						if ((i % 1000) == 0)
+						{
+							std::this_thread::sleep_for(std::chrono::microseconds(t * 100));
+						}
+					});
+				}
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+
+		CHECK(monitor([](std::vector<int>& v) { return v.size(); }) == 20000);
+	}
+}
+
+TEST_CASE("AdaptiveMutex benchmark", "[.][AdaptiveMutex]")
+{
+	const int numThreads = std::max(2, int(std::thread::hardware_concurrency()));
+	constexpr int iterations = 100000;
+
+	for (int work : {0, 100, 1000})
+	{
+		std::println("{} threads, {} iterations of work inside the critical section", numThreads, work);
+		benchmark<std::mutex>("std::mutex", numThreads, iterations, work);
+		benchmark<SpinLock>("SpinLock", numThreads, iterations, work);
+		benchmark<AdaptiveMutex>("AdaptiveMutex", numThreads, iterations, work);
+	}
+}
@@ -0,0 +1,203 @@
+#include "crazygaze/core/Algorithm.h"
+#include <random>
+
+using namespace cz;
+
+namespace
+{
+	std::vector<int> makeRandom(size_t count, uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<int> res(count);
+		for (int& v : res)
+		{
+			v = static_cast<int>(rng() % 100000);
+		}
+		return res;
+	}
+}
+
+TEST_CASE("parallel_for", "[Algorithm]")
+{
+	SECTION("empty and small ranges")
+	{
+		int calls = 0;
+		parallel_for(5, 5, [&](int) { calls++; });
+		parallel_for(5, 0, [&](int) { calls++; });
+		CHECK(calls == 0);
+
+		// Small enough to run on the calling thread
+		std::vector<int> v(10);
+		parallel_for(0, 10, [&](int i) { v[i] = i; });
+		for (int i = 0; i < 10; i++)
+		{
+			CHECK(v[i] == i);
+		}
+	}
+
+	SECTION("every index is visited once")
+	{
+		constexpr int64_t count = 1000000;
+		std::vector<std::atomic<int>> visits(count);
+		parallel_for(int64_t(0), count, [&](int64_t i) { visits[i].fetch_add(1, std::memory_order_relaxed); });
+
+		int64_t bad = 0;
+		for (auto& v : visits)
+		{
+			if (v.load() != 1)
+				bad++;
+		}
+		CHECK(bad == 0);
+	}
+
+	SECTION("non-zero begin and explicit grain size")
+	{
+		std::atomic<int64_t> sum = 0;
+		parallel_for(-100, 1000, [&](int i) { sum.fetch_add(i, std::memory_order_relaxed); }, 1);
+		CHECK(sum.load() == (999 * 1000) / 2 - (100 * 101) / 2);
+	}
+
+	SECTION("sequential cutoff and explicit grain size")
+	{
+		std::mutex mtx;
+		std::set<std::thread::id> threads;
+		auto record = [&]()
+		{
+			std::lock_guard lk(mtx);
+			threads.insert(std::this_thread::get_id());
+		};
+
+		// Up to the cutoff, everything runs on the calling thread
+		parallel_for(size_t(0), ParallelSequentialCutoff, [&](size_t) { record(); });
+		CHECK(threads == std::set<std::thread::id>{std::this_thread::get_id()});
+
+		// Few but expensive elements are still split if we ask for it
+		threads.clear();
+		parallel_for(0, 16, [&](int)
+		{
+			record();
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}, 1);
+		CHECK(threads.size() > 1);
+	}
+
+	SECTION("nested")
+	{
+		constexpr int outer = 64;
+		constexpr int inner = 10000;
+		std::vector<std::vector<int>> rows(outer, std::vector<int>(inner));
+		parallel_for(0, outer, [&](int r)
+		{
+			parallel_for(0, inner, [&](int c) { rows[r][c] = r + c; });
+		}, 1);
+
+		bool ok = true;
+		for (int r = 0; r < outer; r++)
+		{
+			for (int c = 0; c < inner; c++)
+			{
+				ok = ok && rows[r][c] == r + c;
+			}
+		}
+		CHECK(ok);
+	}
+}
+
+TEST_CASE("parallel_for_each and parallel_transform", "[Algorithm]")
+{
+	std::vector<int> v(100000);
+	std::iota(v.begin(), v.end(), 0);
+
+	parallel_for_each(v, [](int& i) { i *= 2; });
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		REQUIRE(v[i] == static_cast<int>(i * 2));
+	}
+
+	std::vector<int64_t> out(v.size());
+	parallel_transform(v, out, [](int i) { return static_cast<int64_t>(i) * i; });
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		REQUIRE(out[i] == static_cast<int64_t>(v[i]) * v[i]);
+	}
+
+	// In place
+	parallel_transform(v, v, [](int i) { return i + 1; });
+	for (size_t i = 0; i < v.size(); i++)
+	{
+		REQUIRE(v[i] == static_cast<int>(i * 2 + 1));
+	}
+}
+
+TEST_CASE("parallel_reduce", "[Algorithm]")
+{
+	std::vector<int64_t> v(1000000);
+	std::iota(v.begin(), v.end(), int64_t(1));
+	const int64_t n = static_cast<int64_t>(v.size());
+
+	CHECK(parallel_reduce(v, int64_t(0)) == n * (n + 1) / 2);
+	CHECK(parallel_reduce(v, int64_t(10)) == n * (n + 1) / 2 + 10);
+	CHECK(parallel_reduce(std::vector<int64_t>{}, int64_t(7)) == 7);
+	CHECK(parallel_reduce(v, int64_t(0), [](int64_t a, int64_t b) { return std::max(a, b); }) == n);
+
+	// With a transform
+	CHECK(parallel_reduce(v, int64_t(0), std::plus<>{}, [](int64_t i) { return i % 2; }) == n / 2);
+
+	// Not commutative, so this checks chunks are combined in order
+	std::vector<std::string> words(5000);
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		words[i] = std::string(1, static_cast<char>('a' + i % 26));
+	}
+	std::string expected;
+	for (const std::string& w : words)
+	{
+		expected += w;
+	}
+	CHECK(parallel_reduce(words, std::string(">"), std::plus<>{}, std::identity{}, 100) == ">" + expected);
+}
+
+TEST_CASE("parallel_sort", "[Algorithm]")
+{
+	SECTION("matches std::sort")
+	{
+		for (size_t count : {size_t(0), size_t(1), size_t(1000), size_t(100001), size_t(1000000)})
+		{
+			std::vector<int> v = makeRandom(count, static_cast<uint32_t>(count));
+			std::vector<int> expected = v;
+			std::sort(expected.begin(), expected.end());
+			parallel_sort(v);
+			CHECK(v == expected);
+		}
+	}
+
+	SECTION("custom comparison and grain size")
+	{
+		std::vector<int> v = makeRandom(50000, 1);
+		std::vector<int> expected = v;
+		std::sort(expected.begin(), expected.end(), std::greater<>{});
+		// Small grain size, so there are lots of merge passes, and the last run is shorter than the others
+		parallel_sort(v, std::greater<>{}, 333);
+		CHECK(v == expected);
+	}
+}
+
+TEST_CASE("parallel_sort benchmark", "[.][Algorithm]")
+{
+	std::vector<int> source = makeRandom(10000000, 2);
+
+	std::vector<int> v = source;
+	auto start = std::chrono::steady_clock::now();
+	std::sort(v.begin(), v.end());
+	auto sequential = std::chrono::steady_clock::now() - start;
+
+	v = source;
+	start = std::chrono::steady_clock::now();
+	parallel_sort(v);
+	auto parallel = std::chrono::steady_clock::now() - start;
+
+	std::println("std::sort: {} ms, parallel_sort: {} ms ({} threads)",
+		std::chrono::duration_cast<std::chrono::milliseconds>(sequential).count(),
+		std::chrono::duration_cast<std::chrono::milliseconds>(parallel).count(), details::getParallelism());
+	CHECK(std::is_sorted(v.begin(), v.end()));
+}
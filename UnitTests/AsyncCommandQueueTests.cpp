@@ -0,0 +1,293 @@
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+TEST_CASE("AsyncCommandQueueBuffered", "[AsyncCommandQueue]")
+{
+	SECTION("multiple producers")
+	{
+		constexpr int numProducers = 4;
+		constexpr int count = 100000;
+		AsyncCommandQueueBuffered q;
+		std::vector<int> res[numProducers];
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < numProducers; p++)
+		{
+			producers.emplace_back([&q, &res, p]()
+			{
+				for (int i = 0; i < count; i++)
+				{
+					q.send([&res, p, i]() { res[p].push_back(i); });
+				}
+			});
+		}
+
+		size_t executed = 0;
+		while (executed < numProducers * count)
+		{
+			executed += q.tick(true);
+		}
+
+		for (auto& t : producers)
+		{
+			t.join();
+		}
+
+		CHECK(q.tick(false) == 0);
+		for (int p = 0; p < numProducers; p++)
+		{
+			REQUIRE(res[p].size() == count);
+			for (int i = 0; i < count; i++)
+			{
+				CHECK(res[p][i] == i);
+			}
+		}
+	}
+
+	SECTION("lvalues are copied")
+	{
+		AsyncCommandQueueBuffered q;
+		int res = 0;
+		{
+			int val = 5;
+			auto f = [val, &res]() { res = val; };
+			q.send(f);
+		}
+		CHECK(q.tick(false) == 1);
+		CHECK(res == 5);
+	}
+
+	SECTION("steady state doesn't allocate")
+	{
+		AsyncCommandQueueBuffered q;
+		std::string str = "Some string that doesn't fit the small string optimization";
+		int64_t res = 0;
+		auto frame = [&]()
+		{
+			for (int i = 0; i < 10000; i++)
+			{
+				q.send([&res, i, ptr = str.c_str()]() { res += i + ptr[0]; });
+			}
+			CHECK(q.tick(false) == 10000);
+		};
+
+		// A couple of frames so both buffers grow enough
+		for (int i = 0; i < 4; i++)
+		{
+			frame();
+		}
+
+		uint64_t allocs = getNumAllocations();
+		for (int i = 0; i < 10; i++)
+		{
+			frame();
+		}
+		CHECK(getNumAllocations() == allocs);
+	}
+}
+
+TEST_CASE("AsyncCommandQueue priorities", "[AsyncCommandQueue]")
+{
+	SECTION("higher lanes first")
+	{
+		AsyncCommandQueueExplicit q;
+		std::vector<int> res;
+		q.send([&res]() { res.push_back(3); }, CommandPriority::Low);
+		q.send([&res]() { res.push_back(2); });
+		q.send([&res]() { res.push_back(1); }, CommandPriority::High);
+		q.send([&res]() { res.push_back(4); }, CommandPriority::Low);
+		CHECK(q.tick(false) == 4);
+		CHECK((res == std::vector<int>{1, 2, 3, 4}));
+	}
+
+	SECTION("only executes what was there at the start")
+	{
+		AsyncCommandQueueExplicit q;
+		std::vector<int> res;
+		q.send([&]()
+		{
+			res.push_back(1);
+			q.send([&res]() { res.push_back(3); }, CommandPriority::High);
+		}, CommandPriority::High);
+		q.send([&res]() { res.push_back(2); }, CommandPriority::Low);
+
+		CHECK(q.tick(false) == 2);
+		CHECK((res == std::vector<int>{1, 2}));
+		CHECK(q.tick(false) == 1);
+		CHECK((res == std::vector<int>{1, 2, 3}));
+		CHECK(q.tick(false) == 0);
+	}
+
+	SECTION("budgets")
+	{
+		AsyncCommandQueueExplicit q;
+		q.setLaneBudget(CommandPriority::Low, 2);
+		int high = 0;
+		int low = 0;
+		for (int i = 0; i < 5; i++)
+		{
+			q.send([&low]() { low++; }, CommandPriority::Low);
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			q.send([&high]() { high++; }, CommandPriority::High);
+		}
+
+		// High priority lane has no budget, but the low priority lane still gets its share every tick
+		CHECK(q.tick(false) == 5);
+		CHECK(high == 3);
+		CHECK(low == 2);
+		CHECK(q.tick(false) == 2);
+		CHECK(low == 4);
+		CHECK(q.tick(false) == 1);
+		CHECK(low == 5);
+	}
+
+	SECTION("wait")
+	{
+		AsyncCommandQueueExplicit q;
+		int res = 0;
+		std::thread producer([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			q.send([&res]() { res = 1; }, CommandPriority::Low);
+		});
+
+		CHECK(q.tick(true) == 1);
+		CHECK(res == 1);
+		producer.join();
+	}
+
+	SECTION("sendWithResult")
+	{
+		AsyncCommandQueueAutomatic q;
+		auto ft = q.sendWithResult([]() { return 10; }, CommandPriority::High);
+		CHECK(ft.get() == 10);
+	}
+}
+
+TEST_CASE("AsyncCommandQueue timers", "[AsyncCommandQueue]")
+{
+	using namespace std::chrono_literals;
+
+	SECTION("sendAfter/sendAt")
+	{
+		AsyncCommandQueueExplicit q;
+		std::vector<int> res;
+		const auto start = TimerWheel::Clock::now();
+		q.sendAfter(20ms, [&res]() { res.push_back(2); });
+		q.sendAt(start + 10ms, [&res]() { res.push_back(1); });
+		CHECK(q.tick(false) == 0);
+
+		// Blocks until the first timer is due
+		CHECK(q.tick(true) == 1);
+		CHECK(TimerWheel::Clock::now() - start >= 10ms);
+		CHECK(q.tick(true) == 1);
+		CHECK(TimerWheel::Clock::now() - start >= 20ms);
+		CHECK((res == std::vector<int>{1, 2}));
+	}
+
+	SECTION("cancelTimer")
+	{
+		AsyncCommandQueueExplicit q;
+		int res = 0;
+		TimerId id = q.sendAfter(10ms, [&res]() { res = 1; });
+		q.sendAfter(20ms, [&res]() { res = 2; });
+		CHECK(q.cancelTimer(id));
+		CHECK(!q.cancelTimer(id));
+		CHECK(q.tick(true) == 1);
+		CHECK(res == 2);
+	}
+
+	SECTION("sendEvery")
+	{
+		AsyncCommandQueueAutomatic q;
+		std::atomic<int> count = 0;
+		Semaphore done;
+		TimerId id = q.sendEvery(2ms, [&]()
+		{
+			if (++count == 5)
+				done.notify();
+		});
+		done.wait();
+		q.cancelTimer(id);
+
+		// Even if the timer was executing when cancelled, it's finished once this executes
+		q.sendWithResult([]() {}).get();
+		const int executed = count;
+		CHECK(executed >= 5);
+		std::this_thread::sleep_for(10ms);
+		CHECK(count == executed);
+	}
+
+	SECTION("new timer wakes up the consumer")
+	{
+		// The consumer is sleeping until a timer far in the future, and a closer one is added
+		AsyncCommandQueueAutomatic q;
+		q.sendAfter(1h, []() {});
+		Semaphore done;
+		std::this_thread::sleep_for(5ms);
+		q.sendAfter(1ms, [&done]() { done.notify(); });
+		CHECK(done.waitUntil(TimerWheel::Clock::now() + 1s));
+	}
+}
+
+TEST_CASE("AsyncCommandQueueAutomatic options", "[AsyncCommandQueue]")
+{
+	SECTION("lazy start")
+	{
+		AsyncCommandQueueAutomatic q;
+		CHECK(!q.isStarted());
+		CHECK(q.sendWithResult([]() { return 1; }).get() == 1);
+		CHECK(q.isStarted());
+
+		AsyncCommandQueueAutomatic unused;
+		CHECK(!unused.isStarted());
+	}
+
+	SECTION("eager start")
+	{
+		AsyncCommandQueueAutomatic q({.lazyStart = false});
+		CHECK(q.isStarted());
+	}
+
+	SECTION("multiple workers")
+	{
+		constexpr uint32_t numWorkers = 4;
+		std::atomic<uint32_t> running = 0;
+		std::atomic<int> count = 0;
+		{
+			AsyncCommandQueueAutomatic q({.numWorkers = numWorkers, .threadName = "Worker"});
+			// Each of these only finishes once all workers are executing one, so this only completes if all workers are
+			// draining the queue
+			for (uint32_t i = 0; i < numWorkers; i++)
+			{
+				q.send([&running]()
+				{
+					running++;
+					while (running < numWorkers)
+						std::this_thread::yield();
+				});
+			}
+
+			for (int i = 0; i < 10000; i++)
+			{
+				q.send([&count]() { count++; });
+			}
+		}
+
+		// Destroying the queue executes everything sent before that
+		CHECK(running == numWorkers);
+		CHECK(count == 10000);
+	}
+
+	SECTION("name, affinity and priority")
+	{
+		AsyncCommandQueueAutomatic q(
+			{.threadName = "MyQueue", .affinityMask = 1, .priority = ThreadPriority::BelowNormal});
+		CHECK(q.sendWithResult([]() { return 1; }).get() == 1);
+	}
+}
@@ -0,0 +1,223 @@
+#include "crazygaze/core/AtomicSharedPtr.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+// Immutable snapshot, where `b` is always `a*2`, so readers can check if they see a consistent object
+struct Snapshot
+{
+	explicit Snapshot(int a)
+		: a(a)
+		, b(a * 2)
+	{
+		alive++;
+	}
+
+	~Snapshot()
+	{
+		alive--;
+	}
+
+	bool isConsistent() const
+	{
+		return b == a * 2;
+	}
+
+	inline static std::atomic<int> alive = 0;
+	int a;
+	int b;
+};
+
+template<typename LoadFunc, typename StoreFunc>
+void benchmark(const char* name, int numReaders, LoadFunc&& loadFunc, StoreFunc&& storeFunc)
+{
+	constexpr int loadsPerThread = 1000000;
+	std::atomic<bool> finished = false;
+	std::thread writer([&]()
+	{
+		int i = 0;
+		while (!finished)
+		{
+			storeFunc(makeShared<const Snapshot>(i++));
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+
+	float ms = measureTimeMs([&]()
+	{
+		std::vector<std::thread> readers;
+		for (int t = 0; t < numReaders; t++)
+		{
+			readers.emplace_back([&]()
+			{
+				for (int i = 0; i < loadsPerThread; i++)
+				{
+					SharedPtr<const Snapshot> snapshot = loadFunc();
+					CHECK(snapshot->isConsistent());
+				}
+			});
+		}
+
+		for (auto& t : readers)
+		{
+			t.join();
+		}
+	});
+
+	finished = true;
+	writer.join();
+
+	std::println("{:>36}: {} readers, {:8.2f} ns per load", name, numReaders, ms * 1000000.0f / float(numReaders * loadsPerThread));
+}
+
+} // anonymous namespace
+
+TEST_CASE("AtomicSharedPtr", "[SmartPointers]")
+{
+	SECTION("load/store/exchange")
+	{
+		{
+			AtomicSharedPtr<const Snapshot> atomicPtr;
+			CHECK(atomicPtr.load() == nullptr);
+
+			auto s1 = makeShared<const Snapshot>(1);
+			atomicPtr.store(s1);
+			CHECK(atomicPtr.load() == s1);
+			// The atomic doesn't hold a reference for `s1` after replacing it
+			auto s2 = makeShared<const Snapshot>(2);
+			SharedPtr<const Snapshot> old = atomicPtr.exchange(s2);
+			CHECK(old == s1);
+			old = nullptr;
+			CHECK(s1.use_count() == 1);
+			s1 = nullptr;
+			CHECK(Snapshot::alive == 1);
+
+			// The atomic keeps the object alive
+			s2 = nullptr;
+			CHECK(Snapshot::alive == 1);
+			CHECK(atomicPtr.load()->a == 2);
+
+			atomicPtr = nullptr;
+			CHECK(Snapshot::alive == 0);
+			CHECK(atomicPtr.load() == nullptr);
+
+			atomicPtr = makeShared<const Snapshot>(3);
+		}
+		// Destroying the atomic releases the object
+		CHECK(Snapshot::alive == 0);
+	}
+
+	SECTION("compare_exchange")
+	{
+		auto s1 = makeShared<const Snapshot>(1);
+		auto s2 = makeShared<const Snapshot>(2);
+		AtomicSharedPtr<const Snapshot> atomicPtr(s1);
+
+		SharedPtr<const Snapshot> expected = s2;
+		CHECK(atomicPtr.compare_exchange_strong(expected, makeShared<const Snapshot>(3)) == false);
+		CHECK(expected == s1);
+		CHECK(Snapshot::alive == 2);
+
+		CHECK(atomicPtr.compare_exchange_strong(expected, s2));
+		CHECK(atomicPtr.load() == s2);
+		expected = nullptr;
+		CHECK(s1.use_count() == 1);
+	}
+
+	SECTION("lots of loads")
+	{
+		// Enough loads to use up the references the atomic holds several times
+		AtomicSharedPtr<const Snapshot> atomicPtr(makeShared<const Snapshot>(1));
+		std::vector<SharedPtr<const Snapshot>> kept;
+		for (int i = 0; i < 200000; i++)
+		{
+			SharedPtr<const Snapshot> ptr = atomicPtr.load();
+			if ((i % 1000) == 0)
+				kept.push_back(std::move(ptr));
+		}
+
+		atomicPtr = nullptr;
+		CHECK(kept.front().use_count() == kept.size());
+		kept.clear();
+		CHECK(Snapshot::alive == 0);
+	}
+
+	SECTION("readers and writers")
+	{
+		{
+			AtomicSharedPtr<const Snapshot> atomicPtr(makeShared<const Snapshot>(0));
+			std::atomic<bool> finished = false;
+			std::atomic<int> inconsistent = 0;
+
+			std::vector<std::thread> readers;
+			for (int t = 0; t < 3; t++)
+			{
+				readers.emplace_back([&]()
+				{
+					int lastSeen = 0;
+					while (!finished)
+					{
+						SharedPtr<const Snapshot> snapshot = atomicPtr.load();
+						if (!snapshot->isConsistent() || snapshot->a < lastSeen)
+							inconsistent++;
+						lastSeen = snapshot->a;
+					}
+				});
+			}
+
+			for (int i = 1; i <= 20000; i++)
+			{
+				atomicPtr.store(makeShared<const Snapshot>(i));
+			}
+
+			finished = true;
+			for (auto& t : readers)
+			{
+				t.join();
+			}
+			CHECK(inconsistent == 0);
+			CHECK(atomicPtr.load()->a == 20000);
+		}
+
+		CHECK(Snapshot::alive == 0);
+	}
+}
+
+TEST_CASE("AtomicWeakPtr", "[SmartPointers]")
+{
+	auto s1 = makeShared<const Snapshot>(1);
+	AtomicWeakPtr<const Snapshot> atomicPtr(s1);
+	CHECK(atomicPtr.load().lock() == s1);
+	// Weak references don't keep the object alive
+	CHECK(s1.use_count() == 1);
+
+	WeakPtr<const Snapshot> old = atomicPtr.exchange(WeakPtr<const Snapshot>());
+	CHECK(old.lock() == s1);
+	CHECK(atomicPtr.load().expired());
+
+	atomicPtr.store(s1);
+	s1 = nullptr;
+	CHECK(Snapshot::alive == 0);
+	CHECK(atomicPtr.load().expired());
+	CHECK(atomicPtr.load().lock() == nullptr);
+}
+
+TEST_CASE("AtomicSharedPtr benchmark", "[.][SmartPointers]")
+{
+	const int maxThreads = std::max(2, int(std::thread::hardware_concurrency()));
+	for (int numReaders = 1; numReaders <= maxThreads; numReaders *= 2)
+	{
+		Monitor<SharedPtr<const Snapshot>> monitor(makeShared<const Snapshot>(0));
+		benchmark("Monitor<SharedPtr>", numReaders,
+			[&]() { return monitor([](SharedPtr<const Snapshot>& p) { return p; }); },
+			[&](SharedPtr<const Snapshot> p) { monitor([&p](SharedPtr<const Snapshot>& current) { current = std::move(p); }); });
+
+		AtomicSharedPtr<const Snapshot> atomicPtr(makeShared<const Snapshot>(0));
+		benchmark("AtomicSharedPtr", numReaders,
+			[&]() { return atomicPtr.load(); },
+			[&](SharedPtr<const Snapshot> p) { atomicPtr.store(std::move(p)); });
+	}
+}
@@ -0,0 +1,229 @@
+#include "crazygaze/core/Command.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+struct Tracker
+{
+	inline static int alive = 0;
+	inline static int calls = 0;
+
+	Tracker()
+	{
+		alive++;
+	}
+
+	Tracker(const Tracker&)
+	{
+		alive++;
+	}
+
+	Tracker(Tracker&&) noexcept
+	{
+		alive++;
+	}
+
+	~Tracker()
+	{
+		alive--;
+	}
+
+	void operator()()
+	{
+		calls++;
+	}
+};
+
+struct BigTracker : Tracker
+{
+	char padding[256];
+};
+
+} // anonymous namespace
+
+TEST_CASE("Command", "[Command]")
+{
+	Tracker::alive = 0;
+	Tracker::calls = 0;
+
+	SECTION("size")
+	{
+		CHECK(sizeof(Command) == 64);
+		CHECK(Command::fitsInline<Tracker>());
+		CHECK(Command::fitsInline<BigTracker>() == false);
+
+		// A std::string and a couple of pointers fit inline
+		std::string str;
+		int* a = nullptr;
+		int* b = nullptr;
+		auto f = [str, a, b]() {};
+		CHECK(Command::fitsInline<decltype(f)>());
+	}
+
+	SECTION("empty")
+	{
+		Command a;
+		CHECK(!a);
+		Command b = nullptr;
+		CHECK(!b);
+	}
+
+	SECTION("inline")
+	{
+		uint64_t allocs = getNumAllocations();
+		{
+			Command a = Tracker();
+			CHECK(a);
+			CHECK(Tracker::alive == 1);
+			a();
+
+			Command b = std::move(a);
+			CHECK(!a);
+			CHECK(Tracker::alive == 1);
+			b();
+			b();
+			CHECK(Tracker::calls == 3);
+
+			b = nullptr;
+			CHECK(Tracker::alive == 0);
+		}
+		CHECK(getNumAllocations() == allocs);
+	}
+
+	SECTION("heap")
+	{
+		uint64_t allocs = getNumAllocations();
+		int calls = Tracker::calls;
+		{
+			Command a = BigTracker();
+			CHECK(Tracker::alive == 1);
+			CHECK(getNumAllocations() == allocs + 1);
+
+			// Moving just moves the pointer
+			Command b = std::move(a);
+			CHECK(getNumAllocations() == allocs + 1);
+			b();
+			CHECK(Tracker::calls == calls + 1);
+
+			Command c = Tracker();
+			c = std::move(b);
+			CHECK(Tracker::alive == 1);
+			c();
+			CHECK(Tracker::calls == calls + 2);
+		}
+		CHECK(Tracker::alive == 0);
+	}
+
+	SECTION("move only captures")
+	{
+		auto ptr = std::make_unique<int>(5);
+		int res = 0;
+		Command a = [ptr = std::move(ptr), &res]() { res = *ptr; };
+		a();
+		CHECK(res == 5);
+	}
+}
+
+TEST_CASE("Command allocations", "[Command]")
+{
+	constexpr int count = 100000;
+	std::string str = "Some string that doesn't fit the small string optimization";
+
+	// Measures the allocations per command after warming up the queue, so we don't count the queue's own growth
+	auto measure = [&](auto& q) -> double
+	{
+		int res = 0;
+		auto pushAll = [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				q.push([&res, i, ptr = str.c_str()]() { res += i + ptr[0]; });
+			}
+		};
+
+		pushAll();
+		while (!q.empty())
+		{
+			q.waitAndPop()();
+		}
+
+		uint64_t allocs = getNumAllocations();
+		pushAll();
+		while (!q.empty())
+		{
+			q.waitAndPop()();
+		}
+		return double(getNumAllocations() - allocs) / count;
+	};
+
+	SharedQueue<std::function<void()>> stdQueue;
+	WorkQueue workQueue;
+	double stdAllocs = measure(stdQueue);
+	double cmdAllocs = measure(workQueue);
+	std::println("Allocations per command: SharedQueue<std::function<void()>>={}, WorkQueue={}", stdAllocs, cmdAllocs);
+	CHECK(cmdAllocs == 0);
+
+	SECTION("AsyncCommandQueue")
+	{
+		AsyncCommandQueueExplicit q;
+		int res = 0;
+		auto sendAll = [&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				q.send([&res, i]() { res += i; });
+			}
+			q.tick(false);
+		};
+
+		sendAll();
+		uint64_t allocs = getNumAllocations();
+		sendAll();
+		CHECK(getNumAllocations() == allocs);
+	}
+}
+
+namespace
+{
+
+template<typename Queue>
+void benchmarkQueue(const char* name)
+{
+	constexpr int count = 1000000;
+	std::string str = "Hello World!";
+	Queue q;
+	int64_t res = 0;
+
+	uint64_t allocs = getNumAllocations();
+	float ms = measureTimeMs([&]()
+	{
+		std::thread consumer([&]()
+		{
+			for (int i = 0; i < count; i++)
+			{
+				q.waitAndPop()();
+			}
+		});
+
+		for (int i = 0; i < count; i++)
+		{
+			q.push([str, i, &res]() { res += i + static_cast<int64_t>(str.size()); });
+		}
+		consumer.join();
+	});
+
+	std::println("{}: {:.2f} ms, {:.3f} allocations per command", name, ms, double(getNumAllocations() - allocs) / count);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Command benchmark", "[.][Command]")
+{
+	benchmarkQueue<SharedQueue<std::function<void()>>>("SharedQueue<std::function<void()>>");
+	benchmarkQueue<WorkQueue>("WorkQueue");
+}
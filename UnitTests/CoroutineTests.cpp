@@ -0,0 +1,122 @@
+#include "crazygaze/core/Coroutine.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "crazygaze/core/ThreadPool.h"
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+Task<int> getValue(int v)
+{
+	co_return v;
+}
+
+Task<int> sum(int a, int b)
+{
+	int res = co_await getValue(a);
+	res += co_await getValue(b);
+	co_return res;
+}
+
+Task<> runSum(int& res, int a, int b)
+{
+	res = co_await sum(a, b);
+}
+
+Task<std::string> hops(AsyncCommandQueue& io, ThreadPool& pool, AsyncCommandQueue& main, std::vector<std::thread::id>& threads)
+{
+	co_await resumeOn(io);
+	threads.push_back(std::this_thread::get_id());
+	std::string data = "Hello";
+
+	co_await resumeOn(pool);
+	CHECK(pool.isWorkerThread());
+	threads.push_back(std::this_thread::get_id());
+	data += " World";
+
+	co_await resumeOn(main);
+	threads.push_back(std::this_thread::get_id());
+	co_return data;
+}
+
+Task<> countdown(AsyncCommandQueue& a, AsyncCommandQueue& b, int count, Semaphore& done)
+{
+	for (int i = 0; i < count; i++)
+	{
+		co_await resumeOn((i % 2) ? a : b);
+	}
+	done.notify();
+}
+
+} // anonymous namespace
+
+TEST_CASE("Coroutine", "[Coroutine]")
+{
+	SECTION("lazy start")
+	{
+		int res = 0;
+		Task<> t = runSum(res, 1, 2);
+		CHECK(res == 0);
+		t.detach();
+		CHECK(res == 3);
+		CHECK(t.valid() == false);
+	}
+
+	SECTION("destroying a task that never ran")
+	{
+		auto ptr = std::make_shared<int>(1);
+		{
+			auto f = [](std::shared_ptr<int> p) -> Task<int> { co_return *p; };
+			Task<int> t = f(ptr);
+			CHECK(ptr.use_count() == 2);
+		}
+		CHECK(ptr.use_count() == 1);
+	}
+
+	SECTION("resumeOn")
+	{
+		// The pool needs to be destroyed last, since the io thread might still be inside `pool.send` when we are done
+		ThreadPool pool(2);
+		AsyncCommandQueueAutomatic io;
+		AsyncCommandQueueAutomatic main;
+		std::vector<std::thread::id> threads;
+		std::string res;
+		Semaphore done;
+
+		[](auto& io, auto& pool, auto& main, auto& threads, std::string& res, Semaphore& done) -> Task<>
+		{
+			res = co_await hops(io, pool, main, threads);
+			done.notify();
+		}(io, pool, main, threads, res, done).detach();
+
+		done.wait();
+		CHECK(res == "Hello World");
+		REQUIRE(threads.size() == 3);
+		CHECK(threads[0] != threads[2]);
+		CHECK(threads[0] != std::this_thread::get_id());
+	}
+
+	SECTION("no allocations per hop")
+	{
+		AsyncCommandQueueAutomatic a;
+		AsyncCommandQueueAutomatic b;
+		Semaphore done;
+
+		// Warm up the queues and the frame allocator.
+		// Doing it twice, since a frame is only freed after the coroutine signals `done`, but by the time the second one finishes,
+		// the first frame is guaranteed to be back in the allocator.
+		for (int i = 0; i < 2; i++)
+		{
+			countdown(a, b, 100, done).detach();
+			done.wait();
+		}
+
+		uint64_t allocs = getNumAllocations();
+		countdown(a, b, 10000, done).detach();
+		done.wait();
+		CHECK(getNumAllocations() == allocs);
+	}
+}
@@ -0,0 +1,123 @@
+#include "crazygaze/core/Future.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "crazygaze/core/ThreadPool.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+TEST_CASE("Future", "[Future]")
+{
+	SECTION("promise and future")
+	{
+		Promise<std::string> p;
+		Future<std::string> f = p.getFuture();
+		CHECK(f.valid());
+		CHECK(f.isReady() == false);
+		p.setValue("Hello");
+		CHECK(f.isReady());
+		CHECK(f.get() == "Hello");
+		CHECK(f.valid() == false);
+	}
+
+	SECTION("move only values")
+	{
+		Promise<std::unique_ptr<int>> p;
+		Future<std::unique_ptr<int>> f = p.getFuture();
+		std::thread t([p = std::move(p)]() mutable
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			p.setValue(std::make_unique<int>(5));
+		});
+		CHECK(*f.get() == 5);
+		t.join();
+	}
+
+	SECTION("sendWithResult")
+	{
+		AsyncCommandQueueAutomatic q;
+		Future<int> a = q.sendWithResult([]() { return 1; });
+		Future<void> b = q.sendWithResult([]() {});
+		CHECK(a.get() == 1);
+		b.get();
+	}
+
+	SECTION("then across queues")
+	{
+		// The pool needs to be destroyed last, since the io thread might still be inside `pool.send` when we are done
+		ThreadPool pool(2);
+		AsyncCommandQueueAutomatic io;
+		AsyncCommandQueueAutomatic main;
+
+		std::thread::id ioThread, mainThread;
+		Future<std::string> f = io.sendWithResult([&]()
+		{
+			ioThread = std::this_thread::get_id();
+			return 10;
+		})
+		.then(pool, [&](int v)
+		{
+			CHECK(pool.isWorkerThread());
+			return v * 2;
+		})
+		.then(main, [&](int v)
+		{
+			mainThread = std::this_thread::get_id();
+			return std::to_string(v);
+		});
+
+		CHECK(f.get() == "20");
+		CHECK(ioThread != mainThread);
+		CHECK(ioThread != std::this_thread::get_id());
+	}
+
+	SECTION("then on a ready future")
+	{
+		AsyncCommandQueueExplicit q;
+		Promise<int> p;
+		Future<int> f = p.getFuture();
+		p.setValue(1);
+
+		Future<void> res = f.then(q, [](int v) { CHECK(v == 1); });
+		CHECK(f.valid() == false);
+		CHECK(res.isReady() == false);
+		q.tick(false);
+		CHECK(res.isReady());
+	}
+
+	SECTION("abandoned promise destroys continuations")
+	{
+		AsyncCommandQueueExplicit q;
+		auto ptr = std::make_shared<int>(1);
+		{
+			Promise<int> p;
+			Future<void> res = p.getFuture().then(q, [ptr](int) {});
+			CHECK(ptr.use_count() == 2);
+		}
+		CHECK(ptr.use_count() == 1);
+		q.tick(false);
+	}
+
+	SECTION("no allocations")
+	{
+		AsyncCommandQueueAutomatic a;
+		AsyncCommandQueueAutomatic b;
+		auto roundTrip = [&](int i)
+		{
+			return a.sendWithResult([i]() { return i; })
+				.then(b, [](int v) { return v + 1; })
+				.get();
+		};
+
+		for (int i = 0; i < 100; i++)
+		{
+			CHECK(roundTrip(i) == i + 1);
+		}
+
+		uint64_t allocs = getNumAllocations();
+		for (int i = 0; i < 1000; i++)
+		{
+			CHECK(roundTrip(i) == i + 1);
+		}
+		CHECK(getNumAllocations() == allocs);
+	}
+}
@@ -0,0 +1,463 @@
+#include "crazygaze/core/LogOutputs.h"
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+using namespace std::chrono_literals;
+
+namespace
+{
+	// Used to check which thread formats a message
+	std::thread::id gFormatThread;
+
+	enum class FormatTracker
+	{
+		Value
+	};
+
+	struct FormatTrackerClass
+	{
+		int value;
+	};
+}
+
+template<>
+struct std::formatter<FormatTracker> : std::formatter<std::string_view>
+{
+	auto format(FormatTracker, std::format_context& ctx) const
+	{
+		gFormatThread = std::this_thread::get_id();
+		return std::formatter<std::string_view>::format("tracker", ctx);
+	}
+};
+
+template<>
+struct std::formatter<FormatTrackerClass> : std::formatter<int>
+{
+	auto format(FormatTrackerClass v, std::format_context& ctx) const
+	{
+		gFormatThread = std::this_thread::get_id();
+		return std::formatter<int>::format(v.value, ctx);
+	}
+};
+
+namespace
+{
+	/**
+	 * Collects messages instead of printing them
+	 */
+	struct CaptureOutput
+	{
+		explicit CaptureOutput(LogOutputs& logs)
+			: logs(logs)
+		{
+			// Get rid of the default console output, so tests don't flood the console
+			logs.remove(&logs);
+			logs.add(this, [this](LogMessage& msg)
+			{
+				if (delay.count())
+					std::this_thread::sleep_for(delay);
+				auto lk = std::lock_guard<std::mutex>(mtx);
+				msgs.emplace_back(msg.msg);
+				timestamps.emplace_back(msg.timestamp);
+				threads.insert(std::this_thread::get_id());
+			});
+		}
+
+		~CaptureOutput()
+		{
+			logs.flush();
+			logs.remove(this);
+		}
+
+		size_t size()
+		{
+			auto lk = std::lock_guard<std::mutex>(mtx);
+			return msgs.size();
+		}
+
+		LogOutputs& logs;
+		std::chrono::milliseconds delay{0};
+		std::mutex mtx;
+		std::vector<std::string> msgs;
+		std::vector<std::string> timestamps;
+		std::set<std::thread::id> threads;
+	};
+
+	void logDirect(LogOutputs& logs, LogLevel level, std::string str)
+	{
+		std::string formatted = str + "\n";
+		LogMessage msg;
+		msg.category = &logMain;
+		msg.level = level;
+		msg.msg = str;
+		msg.formattedMsg = formatted;
+		logs.log(false, msg);
+	}
+}
+
+TEST_CASE("LogOutputs", "[LogOutputs]")
+{
+	LogOutputs logs;
+	CaptureOutput capture(logs);
+
+	SECTION("synchronous")
+	{
+		CHECK(logs.isAsync() == false);
+		CZ_LOG(Main, Log, "Hello {}", 1);
+		REQUIRE(capture.size() == 1);
+		CHECK(capture.msgs[0] == "Hello 1");
+		CHECK(capture.threads.contains(std::this_thread::get_id()));
+
+		// Not async, so these do nothing
+		logs.flush();
+		logs.stopAsync();
+		CHECK(logs.getDroppedCount() == 0);
+	}
+
+	SECTION("asynchronous")
+	{
+		logs.startAsync(64);
+		CHECK(logs.isAsync());
+
+		constexpr int numThreads = 4;
+		constexpr int count = 2000;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < numThreads; t++)
+		{
+			threads.emplace_back([t]()
+			{
+				for (int i = 0; i < count; i++)
+				{
+					CZ_LOG(Main, Log, "{} {}", t, i);
+				}
+			});
+		}
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+
+		logs.flush();
+		REQUIRE(capture.size() == numThreads * count);
+		// Everything was dispatched by the backend thread, in the order each thread logged
+		CHECK(capture.threads.size() == 1);
+		CHECK(!capture.threads.contains(std::this_thread::get_id()));
+		std::vector<int> next(numThreads, 0);
+		bool ordered = true;
+		for (const std::string& str : capture.msgs)
+		{
+			int t, i;
+			std::sscanf(str.c_str(), "%d %d", &t, &i);
+			ordered = ordered && (i == next[t]++);
+		}
+		CHECK(ordered);
+		CHECK(logs.getDroppedCount() == 0);
+
+		// The backend thread is woken up, instead of noticing it should stop when waiting for messages times out
+		auto start = std::chrono::steady_clock::now();
+		logs.stopAsync();
+		CHECK(std::chrono::steady_clock::now() - start < 50ms);
+		CHECK(logs.isAsync() == false);
+		CZ_LOG(Main, Log, "sync again");
+		CHECK(capture.size() == numThreads * count + 1);
+	}
+
+	SECTION("deferred formatting")
+	{
+		logs.startAsync();
+		{
+			std::string str = "str";
+			CZ_LOG(Main, Log, "{} {} {} {} {:.1f} {}", 1, str, "lit", std::string_view("sv"), 2.5, FormatTracker::Value);
+			// The string's contents were copied, so changing it doesn't affect the message
+			str = "changed";
+		}
+		logs.flush();
+		REQUIRE(capture.size() == 1);
+		CHECK(capture.msgs[0] == "1 str lit sv 2.5 tracker");
+		CHECK(gFormatThread != std::this_thread::get_id());
+		CHECK(capture.threads.contains(gFormatThread));
+
+		// Arguments that can't be deferred are formatted right away
+		CZ_LOG(Main, Log, "{}", FormatTrackerClass{7});
+		logs.flush();
+		CHECK(gFormatThread == std::this_thread::get_id());
+
+		// Too big to defer
+		CZ_LOG(Main, Log, "{}{}", std::string(details::MaxDeferredLogArgsSize, 'x'), FormatTracker::Value);
+		logs.flush();
+		CHECK(gFormatThread == std::this_thread::get_id());
+		REQUIRE(capture.size() == 3);
+		CHECK(capture.msgs[1] == "7");
+		CHECK(capture.msgs[2] == std::string(details::MaxDeferredLogArgsSize, 'x') + "tracker");
+
+		// Disabled
+		logs.stopAsync();
+		logs.startAsync(64, QueueOverflowPolicy::Block, false);
+		gFormatThread = {};
+		CZ_LOG(Main, Log, "{}", FormatTracker::Value);
+		logs.flush();
+		CHECK(gFormatThread == std::this_thread::get_id());
+	}
+
+	SECTION("DropNewest")
+	{
+		logs.startAsync(4, QueueOverflowPolicy::DropNewest);
+		capture.delay = 1ms;
+		constexpr int count = 100;
+		for (int i = 0; i < count; i++)
+		{
+			logDirect(logs, LogLevel::Log, std::format("{}", i));
+		}
+
+		logs.flush();
+		const uint64_t dropped = logs.getDroppedCount();
+		CHECK(dropped > 0);
+		CHECK(capture.size() + dropped == count);
+		// The oldest messages are the ones kept
+		CHECK(capture.msgs[0] == "0");
+	}
+
+	SECTION("DropOldest")
+	{
+		logs.startAsync(4, QueueOverflowPolicy::DropOldest);
+		capture.delay = 1ms;
+		constexpr int count = 100;
+		for (int i = 0; i < count; i++)
+		{
+			logDirect(logs, LogLevel::Log, std::format("{}", i));
+		}
+
+		logs.flush();
+		const uint64_t dropped = logs.getDroppedCount();
+		CHECK(dropped > 0);
+		CHECK(capture.size() + dropped == count);
+		// The newest messages are the ones kept
+		CHECK(capture.msgs.back() == std::format("{}", count - 1));
+	}
+
+	SECTION("Fatal messages are flushed")
+	{
+		logs.startAsync(4, QueueOverflowPolicy::DropNewest);
+		capture.delay = 1ms;
+		for (int i = 0; i < 20; i++)
+		{
+			logDirect(logs, LogLevel::Log, "filler");
+		}
+
+		// Fatal messages are never dropped, and `log` only returns once it reached the outputs
+		logDirect(logs, LogLevel::Fatal, "fatal");
+		CHECK(capture.size() + logs.getDroppedCount() == 21);
+		CHECK(capture.msgs.back() == "fatal");
+	}
+
+	SECTION("Fatal messages are written to the log file right away")
+	{
+		for (bool async : {false, true})
+		{
+			if (async)
+				logs.startAsync();
+
+			const std::filesystem::path dir = std::filesystem::temp_directory_path();
+			FileLogOutput file;
+			REQUIRE(file.open(dir.string(), "LogOutputsTests"));
+			for (int i = 0; i < 100; i++)
+			{
+				logDirect(logs, LogLevel::Log, std::format("{}", i));
+			}
+			logDirect(logs, LogLevel::Fatal, "fatal");
+
+			// Not flushing or closing the file, since the process aborts right after a fatal message
+			std::ifstream in(dir / "LogOutputsTests.log");
+			std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			CHECK(contents.starts_with("0\n1\n"));
+			CHECK(contents.ends_with("99\nfatal\n"));
+		}
+	}
+
+	SECTION("Fatal messages are not dropped by DropOldest")
+	{
+		logs.startAsync(4, QueueOverflowPolicy::DropOldest);
+		capture.delay = 1ms;
+		std::atomic<bool> finished = false;
+		std::thread spammer([&]()
+		{
+			while (!finished)
+			{
+				logDirect(logs, LogLevel::Log, "filler");
+			}
+		});
+
+		constexpr int count = 10;
+		for (int i = 0; i < count; i++)
+		{
+			logDirect(logs, LogLevel::Fatal, "fatal");
+		}
+		finished = true;
+		spammer.join();
+		logs.flush();
+		CHECK(std::count(capture.msgs.begin(), capture.msgs.end(), "fatal") == count);
+	}
+
+	SECTION("logging from an output")
+	{
+		// With a small queue, the backend thread would block forever if it pushed to the queue itself
+		logs.startAsync(4, QueueOverflowPolicy::Block);
+		capture.delay = 1ms;
+		int tag;
+		logs.add(&tag, [](LogMessage& msg)
+		{
+			if (msg.msg == "outer")
+				CZ_LOG(Main, Log, "inner");
+		});
+
+		constexpr int count = 20;
+		for (int i = 0; i < count; i++)
+		{
+			CZ_LOG(Main, Log, "outer");
+		}
+		logs.flush();
+		logs.remove(&tag);
+
+		REQUIRE(capture.size() == count * 2);
+		bool ok = true;
+		for (int i = 0; i < count; i++)
+		{
+			ok = ok && capture.msgs[i * 2] == "outer" && capture.msgs[i * 2 + 1] == "inner";
+		}
+		CHECK(ok);
+	}
+
+	SECTION("timestamps")
+	{
+		auto check = [&](LogClock clock)
+		{
+			setLogClock(clock);
+			size_t start = capture.size();
+			for (int i = 0; i < 100; i++)
+			{
+				CZ_LOG(Main, Log, "{}", i);
+			}
+			logs.flush();
+			setLogClock(LogClock::Precise);
+
+			const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count() % (24 * 60 * 60);
+			bool ok = true;
+			for (size_t i = start; i < capture.size(); i++)
+			{
+				// HH:MM:SS:mmm, in UTC
+				const std::string& ts = capture.timestamps[i];
+				int h = -1, m = -1, s = -1, ms = -1;
+				ok = ok && ts.size() == 12 && std::sscanf(ts.c_str(), "%d:%d:%d:%d", &h, &m, &s, &ms) == 4;
+				ok = ok && ms >= 0 && ms < 1000;
+				const int64_t logged = h * 60 * 60 + m * 60 + s;
+				ok = ok && (now - logged + 24 * 60 * 60) % (24 * 60 * 60) <= 2;
+			}
+			CHECK(capture.size() == start + 100);
+			CHECK(ok);
+		};
+
+		check(LogClock::Precise);
+		check(LogClock::Coarse);
+		logs.startAsync();
+		check(LogClock::Coarse);
+	}
+
+	SECTION("long messages")
+	{
+		// Too long to fit in the queue's entries
+		std::string str(1000, 'x');
+		logs.startAsync(64, QueueOverflowPolicy::Block, false);
+		CZ_LOG(Main, Log, "{}", str);
+		logDirect(logs, LogLevel::Log, str);
+		logs.flush();
+		REQUIRE(capture.size() == 2);
+		CHECK(capture.msgs[0] == str);
+		CHECK(capture.msgs[1] == str);
+	}
+}
+
+TEST_CASE("LogOutputs allocations", "[LogOutputs]")
+{
+	LogOutputs logs;
+	logs.remove(&logs);
+	std::atomic<size_t> received = 0;
+	logs.add(&received, [&received](LogMessage& msg)
+	{
+		if (!msg.formattedMsg.empty())
+			received++;
+	});
+
+	auto logMany = [&](int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			CZ_LOG(Main, Log, "Message {} with a float {:.3f} and a string {}", i, i * 0.5f, "hello");
+		}
+		logs.flush();
+	};
+
+	auto check = [&]()
+	{
+		// The first messages grow the buffers
+		logMany(100);
+		received = 0;
+		uint64_t allocs = getNumAllocations();
+		logMany(1000);
+		CHECK(getNumAllocations() == allocs);
+		CHECK(received == 1000);
+	};
+
+	SECTION("synchronous")
+	{
+		check();
+	}
+
+	SECTION("asynchronous")
+	{
+		logs.startAsync(64, QueueOverflowPolicy::Block, false);
+		check();
+	}
+
+	SECTION("deferred formatting")
+	{
+		logs.startAsync(64, QueueOverflowPolicy::Block, true);
+		check();
+	}
+}
+
+TEST_CASE("LogOutputs benchmark", "[.][LogOutputs]")
+{
+	LogOutputs logs;
+	logs.remove(&logs);
+	std::atomic<size_t> received = 0;
+	logs.add(&received, [&received](LogMessage&)
+	{
+		received++;
+	});
+
+	constexpr int count = 200000;
+	auto bench = [&](const char* name)
+	{
+		received = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+		{
+			CZ_LOG(Main, Log, "Message {} with a float {:.3f} and a string {}", i, i * 0.5f, "hello");
+		}
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		logs.flush();
+		CHECK(received == count);
+		std::println("{:>20}: {:8.1f} ns per message on the calling thread", name,
+			std::chrono::duration<double, std::nano>(elapsed).count() / count);
+	};
+
+	bench("synchronous");
+	logs.startAsync(count, QueueOverflowPolicy::Block, false);
+	bench("asynchronous");
+	logs.stopAsync();
+	logs.startAsync(count, QueueOverflowPolicy::Block, true);
+	bench("deferred formatting");
+	logs.stopAsync();
+}
@@ -0,0 +1,117 @@
+#include "crazygaze/core/MPMCQueue.h"
+
+using namespace cz;
+
+TEST_CASE("MPMCQueue", "[MPMCQueue]")
+{
+	SECTION("capacity")
+	{
+		MPMCQueue<int> q(5);
+		CHECK(q.capacity() == 8);
+
+		for (int i = 0; i < 8; i++)
+		{
+			CHECK(q.tryPush(i));
+		}
+		CHECK(q.size() == 8);
+		CHECK(q.tryPush(8) == false);
+
+		int v = -1;
+		for (int i = 0; i < 8; i++)
+		{
+			CHECK(q.tryAndPop(v));
+			CHECK(v == i);
+		}
+		CHECK(q.empty());
+		CHECK(q.tryAndPop(v) == false);
+	}
+
+	SECTION("destroys items left in the queue")
+	{
+		auto ptr = std::make_shared<int>(1);
+		{
+			MPMCQueue<std::shared_ptr<int>> q;
+			q.push(ptr);
+			q.push(ptr);
+			CHECK(ptr.use_count() == 3);
+		}
+		CHECK(ptr.use_count() == 1);
+	}
+
+	SECTION("popAll")
+	{
+		MPMCQueue<int> q;
+		q.push(1);
+		q.emplace(2);
+		std::queue<int> dest;
+		CHECK(q.popAll(dest));
+		CHECK(dest.size() == 2);
+		CHECK(q.empty());
+	}
+
+	SECTION("waitAndPop timeout")
+	{
+		MPMCQueue<int> q;
+		int v;
+		CHECK(q.waitAndPop(v, 10) == false);
+	}
+
+	SECTION("multiple producers and consumers")
+	{
+		constexpr int numProducers = 4;
+		constexpr int numConsumers = 4;
+		constexpr int itemsPerProducer = 100000;
+
+		// Using a small capacity, so producers also hit the "full" case
+		MPMCQueue<int> q(64);
+		std::atomic<int64_t> sum = 0;
+		std::atomic<int> received = 0;
+		std::vector<std::thread> threads;
+
+		for (int c = 0; c < numConsumers; c++)
+		{
+			threads.emplace_back([&]()
+			{
+				while (true)
+				{
+					int v = q.waitAndPop();
+					if (v < 0)
+						return;
+					sum += v;
+					received++;
+				}
+			});
+		}
+
+		for (int p = 0; p < numProducers; p++)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int i = 1; i <= itemsPerProducer; i++)
+				{
+					q.push(i);
+				}
+			});
+		}
+
+		for (int p = numConsumers; p < numConsumers + numProducers; p++)
+		{
+			threads[p].join();
+		}
+
+		// One stop marker per consumer
+		for (int c = 0; c < numConsumers; c++)
+		{
+			q.push(-1);
+		}
+
+		for (int c = 0; c < numConsumers; c++)
+		{
+			threads[c].join();
+		}
+
+		CHECK(received == numProducers * itemsPerProducer);
+		CHECK(sum == int64_t(numProducers) * (int64_t(itemsPerProducer) * (itemsPerProducer + 1) / 2));
+		CHECK(q.empty());
+	}
+}
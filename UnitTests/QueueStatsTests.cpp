@@ -0,0 +1,137 @@
+#include "crazygaze/core/QueueStats.h"
+#include "crazygaze/core/SharedQueue.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "TestUtils.h"
+
+using namespace cz;
+using namespace std::chrono_literals;
+
+TEST_CASE("LatencyHistogram", "[QueueStats]")
+{
+	LatencyHistogram h;
+	CHECK(h.percentile(50) == 0ns);
+
+	CHECK(LatencyHistogram::calcBucket(0) == 0);
+	CHECK(LatencyHistogram::calcBucket(1) == 0);
+	CHECK(LatencyHistogram::calcBucket(2) == 1);
+	CHECK(LatencyHistogram::calcBucket(1023) == 9);
+	CHECK(LatencyHistogram::calcBucket(1024) == 10);
+	CHECK(LatencyHistogram::calcBucket(UINT64_MAX) == LatencyHistogram::NumBuckets - 1);
+
+	// 90 fast samples, and 10 slow ones
+	for (int i = 0; i < 90; i++)
+	{
+		h.add(100);
+	}
+	for (int i = 0; i < 10; i++)
+	{
+		h.add(1000000);
+	}
+
+	CHECK(h.count == 100);
+	CHECK(h.mean() == 100090ns);
+	CHECK(h.max() == 1000000ns);
+	// Percentiles are reported as the end of the bucket
+	CHECK(h.percentile(50) == 127ns);
+	CHECK(h.percentile(90) == 127ns);
+	CHECK(h.percentile(91) == 1000000ns);
+
+	LatencyHistogram other;
+	other.add(5);
+	h.merge(other);
+	CHECK(h.count == 101);
+	CHECK(h.buckets[LatencyHistogram::calcBucket(5)] == 1);
+}
+
+TEST_CASE("QueueStats", "[QueueStats]")
+{
+	SECTION("SharedQueue")
+	{
+		QueueStats stats("Test");
+		SharedQueue<int> q;
+		q.setStats(&stats);
+
+		q.push(1);
+		q.emplace(2);
+		q.pushBulk(std::vector<int>{3, 4, 5});
+		std::this_thread::sleep_for(2ms);
+
+		int v;
+		CHECK(q.tryAndPop(v));
+		std::vector<int> dest;
+		CHECK(q.popUpTo(dest, 2) == 2);
+
+		QueueStats::Snapshot snapshot = stats.getSnapshot();
+		CHECK(snapshot.depth == 2);
+		CHECK(snapshot.highWaterDepth == 5);
+		CHECK(snapshot.pushed == 5);
+		CHECK(snapshot.popped == 3);
+		CHECK(snapshot.queueLatency.count == 3);
+		CHECK(snapshot.queueLatency.percentile(0) >= 1ms);
+
+		SharedQueue<int>::Queue all;
+		CHECK(q.popAll(all));
+		snapshot = stats.getSnapshot();
+		CHECK(snapshot.depth == 0);
+		CHECK(snapshot.queueLatency.count == 5);
+		CHECK(snapshot.execTime.count == 0);
+	}
+
+	SECTION("multiple threads")
+	{
+		constexpr int numProducers = 4;
+		constexpr int count = 10000;
+		QueueStats stats;
+		SharedQueue<int> q;
+		q.setStats(&stats);
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < numProducers; p++)
+		{
+			producers.emplace_back([&q]()
+			{
+				for (int i = 0; i < count; i++)
+				{
+					q.push(i);
+				}
+			});
+		}
+
+		for (int i = 0; i < numProducers * count; i++)
+		{
+			q.waitAndPop();
+		}
+
+		for (auto& t : producers)
+		{
+			t.join();
+		}
+
+		QueueStats::Snapshot snapshot = stats.getSnapshot();
+		CHECK(snapshot.depth == 0);
+		CHECK(snapshot.highWaterDepth >= 1);
+		CHECK(snapshot.pushed == numProducers * count);
+		CHECK(snapshot.popped == numProducers * count);
+		CHECK(snapshot.queueLatency.count == numProducers * count);
+	}
+
+	SECTION("AsyncCommandQueue")
+	{
+		QueueStats stats;
+		AsyncCommandQueueExplicit q;
+		q.setStats(&stats);
+		q.send([]() { std::this_thread::sleep_for(2ms); });
+		q.send([]() {}, CommandPriority::Low);
+		q.sendAt(TimerWheel::Clock::now(), []() {});
+		while (stats.getSnapshot().execTime.count != 3)
+		{
+			q.tick(true);
+		}
+
+		QueueStats::Snapshot snapshot = stats.getSnapshot();
+		// Timers don't go through the lanes, so they only count towards execution time
+		CHECK(snapshot.pushed == 2);
+		CHECK(snapshot.depth == 0);
+		CHECK(snapshot.execTime.max() >= 2ms);
+	}
+}
@@ -0,0 +1,70 @@
+#include "crazygaze/core/RingBuffer.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+TEST_CASE("RingBuffer", "[RingBuffer]")
+{
+	SECTION("FIFO with wrap around")
+	{
+		std::queue<int, RingBuffer<int>> q;
+		int next = 0;
+		int expected = 0;
+		for (int round = 0; round < 100; round++)
+		{
+			for (int i = 0; i < 7; i++)
+			{
+				q.push(next++);
+			}
+			for (int i = 0; i < 5; i++)
+			{
+				CHECK(q.front() == expected++);
+				q.pop();
+			}
+		}
+
+		CHECK(q.size() == 200);
+		CHECK(q.back() == next - 1);
+		while (!q.empty())
+		{
+			CHECK(q.front() == expected++);
+			q.pop();
+		}
+	}
+
+	SECTION("doesn't allocate once it has enough capacity")
+	{
+		RingBuffer<std::string> r;
+		for (int i = 0; i < 100; i++)
+		{
+			r.emplace_back("A");
+		}
+		r.clear();
+
+		uint64_t allocs = getNumAllocations();
+		for (int round = 0; round < 1000; round++)
+		{
+			r.emplace_back("A");
+			r.emplace_back("B");
+			r.pop_front();
+			r.pop_front();
+		}
+		CHECK(getNumAllocations() == allocs);
+	}
+
+	SECTION("destroys items")
+	{
+		auto ptr = std::make_shared<int>(1);
+		{
+			RingBuffer<std::shared_ptr<int>> a;
+			a.push_back(ptr);
+			a.push_back(ptr);
+			RingBuffer<std::shared_ptr<int>> b;
+			swap(a, b);
+			CHECK(a.empty());
+			CHECK(b.size() == 2);
+			CHECK(ptr.use_count() == 3);
+		}
+		CHECK(ptr.use_count() == 1);
+	}
+}
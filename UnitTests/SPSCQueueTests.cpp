@@ -0,0 +1,104 @@
+#include "crazygaze/core/SPSCQueue.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+
+using namespace cz;
+
+TEST_CASE("SPSCQueue", "[SPSCQueue]")
+{
+	SECTION("capacity")
+	{
+		SPSCQueue<int> q(3);
+		CHECK(q.capacity() == 4);
+		for (int i = 0; i < 4; i++)
+		{
+			CHECK(q.tryPush(i));
+		}
+		CHECK(q.tryPush(4) == false);
+		CHECK(q.size() == 4);
+
+		CHECK(*q.front() == 0);
+		q.pop();
+
+		int v = -1;
+		for (int i = 1; i < 4; i++)
+		{
+			CHECK(q.tryAndPop(v));
+			CHECK(v == i);
+		}
+		CHECK(q.empty());
+		CHECK(q.front() == nullptr);
+	}
+
+	SECTION("destroys items left in the queue")
+	{
+		auto ptr = std::make_shared<int>(1);
+		{
+			SPSCQueue<std::shared_ptr<int>> q;
+			q.push(ptr);
+			q.push(ptr);
+			CHECK(ptr.use_count() == 3);
+		}
+		CHECK(ptr.use_count() == 1);
+	}
+
+	SECTION("producer and consumer")
+	{
+		constexpr int count = 1000000;
+		SPSCQueue<int> q(128);
+		int64_t sum = 0;
+		std::thread consumer([&]()
+		{
+			int received = 0;
+			int v;
+			while (received < count)
+			{
+				if (q.tryAndPop(v))
+				{
+					CHECK(v == received);
+					sum += v;
+					received++;
+				}
+			}
+		});
+
+		for (int i = 0; i < count; i++)
+		{
+			q.push(i);
+		}
+		consumer.join();
+		CHECK(sum == int64_t(count) * (count - 1) / 2);
+	}
+}
+
+TEST_CASE("AsyncCommandQueueSPSC", "[SPSCQueue]")
+{
+	constexpr int count = 100000;
+	std::vector<int> res;
+	Semaphore done;
+
+	{
+		AsyncCommandQueueSPSC q(256);
+		for (int i = 0; i < count; i++)
+		{
+			q.send([i, &res]()
+			{
+				res.push_back(i);
+			});
+
+			// Give the consumer thread the chance to park every now and then
+			if ((i % 10000) == 0)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		q.send([&done]() { done.notify(); });
+		done.wait();
+	}
+
+	REQUIRE(res.size() == count);
+	for (int i = 0; i < count; i++)
+	{
+		CHECK(res[i] == i);
+	}
+}
@@ -0,0 +1,185 @@
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+// Mutex + condition variable semaphore, to compare against in the benchmarks
+class MutexSemaphore
+{
+  public:
+	void notify()
+	{
+		std::lock_guard lk(m_mtx);
+		m_count++;
+		m_cv.notify_one();
+	}
+
+	void wait()
+	{
+		std::unique_lock lk(m_mtx);
+		m_cv.wait(lk, [this]() { return m_count > 0; });
+		m_count--;
+	}
+
+  private:
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	unsigned int m_count = 0;
+};
+
+template<typename Sem>
+void pingPong(const char* name, int count)
+{
+	Sem ping;
+	Sem pong;
+	std::thread other([&]()
+	{
+		for (int i = 0; i < count; i++)
+		{
+			ping.wait();
+			pong.notify();
+		}
+	});
+
+	float ms = measureTimeMs([&]()
+	{
+		for (int i = 0; i < count; i++)
+		{
+			ping.notify();
+			pong.wait();
+		}
+	});
+	other.join();
+
+	std::println("{}: {:.0f} ns per round trip", name, ms * 1000000.0f / float(count));
+}
+
+} // anonymous namespace
+
+TEST_CASE("Semaphore", "[Semaphore]")
+{
+	SECTION("initial count")
+	{
+		Semaphore sem(2);
+		CHECK(sem.trywait());
+		CHECK(sem.trywait());
+		CHECK(sem.trywait() == false);
+		sem.notify();
+		sem.wait();
+		CHECK(sem.trywait() == false);
+	}
+
+	SECTION("waitUntil timeout")
+	{
+		Semaphore sem;
+		auto start = std::chrono::steady_clock::now();
+		CHECK(sem.waitUntil(start + std::chrono::milliseconds(20)) == false);
+		CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+		// The timed out wait must not have consumed anything
+		sem.notify();
+		CHECK(sem.trywait());
+		CHECK(sem.trywait() == false);
+
+		sem.notify();
+		CHECK(sem.waitUntil(std::chrono::system_clock::now() + std::chrono::milliseconds(1)));
+	}
+
+	SECTION("multiple producers and consumers")
+	{
+		constexpr int numThreads = 4;
+		constexpr int count = 50000;
+		Semaphore sem;
+		std::atomic<int> consumed = 0;
+		std::vector<std::thread> threads;
+
+		for (int i = 0; i < numThreads; i++)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int j = 0; j < count; j++)
+				{
+					// Mix blocking and timed waits, so timeouts race against notifies
+					if (j % 2)
+					{
+						sem.wait();
+					}
+					else
+					{
+						while (!sem.waitUntil(std::chrono::steady_clock::now() + std::chrono::microseconds(50)))
+						{
+						}
+					}
+					consumed++;
+				}
+			});
+
+			threads.emplace_back([&]()
+			{
+				for (int j = 0; j < count; j++)
+				{
+					sem.notify();
+				}
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+
+		CHECK(consumed == numThreads * count);
+		CHECK(sem.trywait() == false);
+	}
+}
+
+TEST_CASE("ZeroSemaphore", "[Semaphore]")
+{
+	ZeroSemaphore sem;
+	CHECK(sem.trywait());
+
+	constexpr int numThreads = 8;
+	for (int i = 0; i < numThreads; i++)
+	{
+		sem.increment();
+	}
+	CHECK(sem.trywait() == false);
+
+	std::atomic<int> done = 0;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < numThreads; i++)
+	{
+		threads.emplace_back([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			done++;
+			sem.decrement();
+		});
+	}
+
+	std::thread waiter([&]()
+	{
+		sem.wait();
+		CHECK(done == numThreads);
+	});
+
+	sem.wait();
+	CHECK(done == numThreads);
+	CHECK(sem.trywait());
+
+	waiter.join();
+	for (auto& t : threads)
+	{
+		t.join();
+	}
+}
+
+TEST_CASE("Semaphore benchmark", "[.][Semaphore]")
+{
+	constexpr int count = 200000;
+	pingPong<MutexSemaphore>("std::mutex + std::condition_variable", count);
+	pingPong<Semaphore>("Semaphore", count);
+}
@@ -0,0 +1,185 @@
+#include "crazygaze/core/ThreadingUtils.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+// Not a multiple of 8 bytes on purpose, to test the last partial word
+struct Triple
+{
+	uint64_t a = 0;
+	uint64_t b = 0;
+	uint32_t c = 0;
+
+	bool isConsistent() const
+	{
+		return a == b && b == c;
+	}
+};
+
+struct Routes
+{
+	int values[8] = {};
+};
+
+/**
+ * Measures how many reads per second `numReaders` threads can do, while another thread writes every now and then
+ */
+template<typename ReadFunc, typename WriteFunc>
+void benchmark(const char* name, int numReaders, ReadFunc&& readFunc, WriteFunc&& writeFunc)
+{
+	constexpr int readsPerThread = 1000000;
+	std::atomic<bool> finished = false;
+
+	std::thread writer([&]()
+	{
+		int i = 0;
+		while (!finished)
+		{
+			writeFunc(i++);
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	});
+
+	float ms = measureTimeMs([&]()
+	{
+		std::vector<std::thread> readers;
+		for (int t = 0; t < numReaders; t++)
+		{
+			readers.emplace_back([&]()
+			{
+				int sum = 0;
+				for (int i = 0; i < readsPerThread; i++)
+				{
+					sum += readFunc();
+				}
+				CHECK(sum != -1);
+			});
+		}
+
+		for (auto& t : readers)
+		{
+			t.join();
+		}
+	});
+
+	finished = true;
+	writer.join();
+
+	std::println("{:>14}: {} readers, {:8.2f} M reads per second", name, numReaders,
+		float(numReaders) * readsPerThread / (ms * 1000.0f));
+}
+
+} // anonymous namespace
+
+TEST_CASE("SharedMonitor", "[SeqLock]")
+{
+	SharedMonitor<std::vector<int>> monitor;
+	monitor.write([](std::vector<int>& v) { v.push_back(1); });
+
+	// Both readers need to be inside `read` at the same time for this to finish
+	std::atomic<int> inside = 0;
+	auto reader = [&]()
+	{
+		int size = monitor.read([&](const std::vector<int>& v)
+		{
+			inside++;
+			while (inside.load() != 2)
+			{
+				std::this_thread::yield();
+			}
+			return int(v.size());
+		});
+		CHECK(size == 1);
+	};
+
+	std::thread other(reader);
+	reader();
+	other.join();
+
+	CHECK(monitor.write([](std::vector<int>& v) { v.push_back(2); return v.size(); }) == 2);
+}
+
+TEST_CASE("SeqLock", "[SeqLock]")
+{
+	SECTION("single thread")
+	{
+		SeqLock<Triple> lock;
+		CHECK(lock.load().isConsistent());
+		lock.store({5, 5, 5});
+		CHECK(lock.load().a == 5);
+		lock.update([](Triple& t) { t.a++; t.b++; t.c++; });
+		Triple t = lock.load();
+		CHECK(t.isConsistent());
+		CHECK(t.a == 6);
+	}
+
+	SECTION("readers never see partial writes")
+	{
+		SeqLock<Triple> lock;
+		std::atomic<bool> finished = false;
+		std::atomic<int> inconsistent = 0;
+
+		std::vector<std::thread> threads;
+		// 2 writers
+		for (int w = 0; w < 2; w++)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int i = 0; i < 20000; i++)
+				{
+					lock.update([](Triple& t) { t.a++; t.b++; t.c++; });
+				}
+			});
+		}
+
+		// 2 readers
+		for (int r = 0; r < 2; r++)
+		{
+			threads.emplace_back([&]()
+			{
+				while (!finished)
+				{
+					if (!lock.load().isConsistent())
+						inconsistent++;
+				}
+			});
+		}
+
+		threads[0].join();
+		threads[1].join();
+		finished = true;
+		threads[2].join();
+		threads[3].join();
+
+		CHECK(inconsistent == 0);
+		// Updates from both writers are serialized, so none should be lost
+		CHECK(lock.load().a == 40000);
+	}
+}
+
+TEST_CASE("SeqLock benchmark", "[.][SeqLock]")
+{
+	const int maxThreads = std::max(2, int(std::thread::hardware_concurrency()));
+	for (int numReaders = 1; numReaders <= maxThreads; numReaders *= 2)
+	{
+		Monitor<Routes> monitor;
+		benchmark("Monitor", numReaders,
+			[&]() { return monitor([](Routes& r) { return r.values[0]; }); },
+			[&](int v) { monitor([v](Routes& r) { r.values[0] = v; }); });
+
+		SharedMonitor<Routes> sharedMonitor;
+		benchmark("SharedMonitor", numReaders,
+			[&]() { return sharedMonitor.read([](const Routes& r) { return r.values[0]; }); },
+			[&](int v) { sharedMonitor.write([v](Routes& r) { r.values[0] = v; }); });
+
+		SeqLock<Routes> seqLock;
+		benchmark("SeqLock", numReaders,
+			[&]() { return seqLock.load().values[0]; },
+			[&](int v) { seqLock.update([v](Routes& r) { r.values[0] = v; }); });
+
+		std::println("");
+	}
+}
@@ -0,0 +1,218 @@
+#include "crazygaze/core/SharedQueue.h"
+
+using namespace cz;
+
+TEST_CASE("SharedQueue bulk operations", "[SharedQueue]")
+{
+	SECTION("pushBulk copies or moves")
+	{
+		SharedQueue<std::unique_ptr<int>> q;
+		std::vector<std::unique_ptr<int>> src;
+		for (int i = 0; i < 5; i++)
+		{
+			src.push_back(std::make_unique<int>(i));
+		}
+
+		CHECK(q.pushBulk(src | std::views::as_rvalue) == 5);
+		CHECK(src[0] == nullptr);
+
+		std::vector<std::unique_ptr<int>> dst;
+		CHECK(q.popUpTo(dst, 3) == 3);
+		CHECK(q.popUpTo(dst, 10) == 2);
+		CHECK(q.popUpTo(dst, 10) == 0);
+		REQUIRE(dst.size() == 5);
+		for (int i = 0; i < 5; i++)
+		{
+			CHECK(*dst[i] == i);
+		}
+
+		SharedQueue<std::string> sq;
+		std::vector<std::string> strs = {"A", "B"};
+		CHECK(sq.pushBulk(strs) == 2);
+		CHECK(strs[0] == "A");
+		CHECK(sq.emplaceBulk(std::vector<const char*>{"C", "D", "E"}) == 5);
+
+		std::string out[4];
+		CHECK(sq.popUpTo(std::span<std::string>(out)) == 4);
+		CHECK(out[0] == "A");
+		CHECK(out[3] == "D");
+		CHECK(sq.size() == 1);
+	}
+
+	SECTION("waitAndPopUpTo timeout")
+	{
+		SharedQueue<int> q;
+		std::vector<int> dst;
+		CHECK(q.waitAndPopUpTo(dst, 10, 1) == 0);
+
+		int buf[2];
+		CHECK(q.waitAndPopUpTo(std::span<int>(buf), 1) == 0);
+	}
+
+	SECTION("multiple consumers")
+	{
+		constexpr int numConsumers = 4;
+		constexpr int numBatches = 1000;
+		constexpr int batchSize = 200;
+		SharedQueue<int> q;
+		std::atomic<int64_t> sum = 0;
+		std::atomic<int> received = 0;
+
+		std::vector<std::thread> consumers;
+		for (int i = 0; i < numConsumers; i++)
+		{
+			consumers.emplace_back([&]()
+			{
+				std::vector<int> items;
+				while (received.load() < numBatches * batchSize)
+				{
+					items.clear();
+					size_t count = q.waitAndPopUpTo(items, 64, 10);
+					for (int v : items)
+					{
+						sum += v;
+					}
+					received += static_cast<int>(count);
+				}
+			});
+		}
+
+		std::vector<int> batch(batchSize);
+		std::iota(batch.begin(), batch.end(), 0);
+		for (int i = 0; i < numBatches; i++)
+		{
+			q.pushBulk(batch);
+		}
+
+		for (auto& t : consumers)
+		{
+			t.join();
+		}
+
+		CHECK(received == numBatches * batchSize);
+		CHECK(sum == int64_t(numBatches) * batchSize * (batchSize - 1) / 2);
+	}
+}
+
+TEST_CASE("SharedQueue bounded", "[SharedQueue]")
+{
+	using namespace std::chrono_literals;
+
+	auto popAll = [](auto& q)
+	{
+		std::vector<int> res;
+		q.popUpTo(res, 100);
+		return res;
+	};
+
+	SECTION("tryPush and pushFor")
+	{
+		SharedQueue<std::unique_ptr<int>> q(2);
+		CHECK(q.tryPush(std::make_unique<int>(1)));
+		CHECK(q.tryPush(std::make_unique<int>(2)));
+
+		// Failing doesn't consume the item
+		auto item = std::make_unique<int>(3);
+		CHECK(!q.tryPush(std::move(item)));
+		CHECK(item != nullptr);
+		CHECK(!q.pushFor(std::move(item), 1ms));
+		CHECK(item != nullptr);
+		CHECK(q.size() == 2);
+		CHECK(q.getDroppedCount() == 0);
+
+		std::thread consumer([&q]()
+		{
+			std::this_thread::sleep_for(5ms);
+			q.waitAndPop();
+		});
+		CHECK(q.pushFor(std::move(item), 10s));
+		CHECK(item == nullptr);
+		consumer.join();
+	}
+
+	SECTION("DropNewest")
+	{
+		SharedQueue<int> q(2, QueueOverflowPolicy::DropNewest);
+		CHECK(q.push(1) == 1);
+		CHECK(q.push(2) == 2);
+		CHECK(q.push(3) == 2);
+		CHECK(q.emplace(4) == 2);
+		CHECK(q.getDroppedCount() == 2);
+		CHECK((popAll(q) == std::vector<int>{1, 2}));
+	}
+
+	SECTION("DropOldest")
+	{
+		QueueStats stats;
+		SharedQueue<int> q(2, QueueOverflowPolicy::DropOldest);
+		q.setStats(&stats);
+		CHECK(q.pushBulk(std::vector<int>{1, 2, 3, 4}) == 2);
+		CHECK(q.getDroppedCount() == 2);
+		CHECK((popAll(q) == std::vector<int>{3, 4}));
+
+		QueueStats::Snapshot snapshot = stats.getSnapshot();
+		CHECK(snapshot.depth == 0);
+		CHECK(snapshot.highWaterDepth == 2);
+		CHECK(snapshot.dropped == 2);
+	}
+
+	SECTION("Overwrite")
+	{
+		SharedQueue<int> q(2, QueueOverflowPolicy::Overwrite);
+		q.push(1);
+		q.push(2);
+		q.push(3);
+		q.push(4);
+		CHECK(q.getDroppedCount() == 2);
+		CHECK((popAll(q) == std::vector<int>{1, 4}));
+	}
+
+	SECTION("Block")
+	{
+		constexpr int numProducers = 4;
+		constexpr int count = 10000;
+		constexpr size_t capacity = 8;
+		SharedQueue<int> q(capacity);
+		std::atomic<bool> overflowed = false;
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < numProducers; p++)
+		{
+			producers.emplace_back([&]()
+			{
+				for (int i = 0; i < count; i++)
+				{
+					if (q.push(i) > capacity)
+						overflowed = true;
+				}
+			});
+		}
+
+		// Bulk pushes bigger than the capacity block halfway through, until the consumer makes room
+		std::thread bulkProducer([&q]()
+		{
+			std::vector<int> items(100, 1);
+			q.pushBulk(items);
+		});
+
+		int64_t received = 0;
+		std::vector<int> batch;
+		while (received < numProducers * count + 100)
+		{
+			batch.clear();
+			received += q.waitAndPopUpTo(batch, 3, 1000);
+			if (q.size() > capacity)
+				overflowed = true;
+		}
+
+		for (auto& t : producers)
+		{
+			t.join();
+		}
+		bulkProducer.join();
+
+		CHECK(!overflowed);
+		CHECK(q.getDroppedCount() == 0);
+		CHECK(q.size() == 0);
+	}
+}
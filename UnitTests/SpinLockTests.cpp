@@ -0,0 +1,157 @@
+#include "crazygaze/core/ThreadingUtils.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+/**
+ * Runs `numThreads` threads, each locking/unlocking `lock` `iterations` times, and incrementing a shared counter while holding
+ * the lock.
+ * Returns how long it took, and the number of times each thread got the lock during the time all of them were running.
+ */
+template<typename Lock>
+std::pair<float, std::vector<uint64_t>> contend(Lock& lock, int numThreads, int iterations)
+{
+	uint64_t counter = 0;
+	std::atomic<int> ready = 0;
+	std::atomic<bool> stop = false;
+	std::vector<uint64_t> acquisitions(numThreads, 0);
+
+	float ms = measureTimeMs([&]()
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < numThreads; t++)
+		{
+			threads.emplace_back([&, t]()
+			{
+				ready++;
+				while (ready.load() != numThreads)
+				{
+				}
+
+				uint64_t count = 0;
+				for (int i = 0; i < iterations; i++)
+				{
+					std::lock_guard lk(lock);
+					counter++;
+					// Only count while all the threads are competing for the lock
+					if (!stop.load(std::memory_order_relaxed))
+					{
+						count++;
+					}
+				}
+				stop = true;
+				acquisitions[t] = count;
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+	});
+
+	CHECK(counter == uint64_t(numThreads) * iterations);
+	return {ms, std::move(acquisitions)};
+}
+
+template<typename Lock>
+void benchmark(const char* name, int numThreads, int iterations)
+{
+	Lock lock;
+	auto [ms, acquisitions] = contend(lock, numThreads, iterations);
+	auto [minIt, maxIt] = std::minmax_element(acquisitions.begin(), acquisitions.end());
+	std::println("{:>16}: {:5} threads, {:8.2f} ns per lock/unlock, acquisitions per thread min/max={}/{}",
+		name, numThreads, ms * 1000000.0f / float(numThreads * iterations), *minIt, *maxIt);
+}
+
+} // anonymous namespace
+
+TEMPLATE_TEST_CASE("Locks", "[SpinLock]", SpinLock, BackoffSpinLock, TicketSpinLock, MCSSpinLock)
+{
+	SECTION("try_lock")
+	{
+		TestType lock;
+		CHECK(lock.try_lock());
+		CHECK(lock.try_lock() == false);
+		std::thread([&]()
+		{
+			CHECK(lock.try_lock() == false);
+		}).join();
+		lock.unlock();
+		CHECK(lock.try_lock());
+		lock.unlock();
+	}
+
+	SECTION("Monitor")
+	{
+		Monitor<std::vector<int>, TestType> monitor;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++)
+		{
+			threads.emplace_back([&]()
+			{
+				for (int i = 0; i < 1000; i++)
+				{
+					monitor([i](std::vector<int>& v) { v.push_back(i); });
+				}
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+
+		CHECK(monitor([](std::vector<int>& v) { return v.size(); }) == 4000);
+	}
+
+	SECTION("contention")
+	{
+		TestType lock;
+		contend(lock, 8, 20000);
+	}
+}
+
+TEST_CASE("MCSSpinLock nested", "[SpinLock]")
+{
+	// Locks don't need to be released in the reverse order they were acquired
+	MCSSpinLock locks[MCSSpinLock::MaxHeldLocks];
+	for (auto& l : locks)
+	{
+		l.lock();
+	}
+
+	for (size_t i = 0; i < MCSSpinLock::MaxHeldLocks; i += 2)
+	{
+		locks[i].unlock();
+	}
+
+	for (size_t i = 1; i < MCSSpinLock::MaxHeldLocks; i += 2)
+	{
+		locks[i].unlock();
+	}
+
+	for (auto& l : locks)
+	{
+		CHECK(l.try_lock());
+		l.unlock();
+	}
+}
+
+TEST_CASE("Locks benchmark", "[.][SpinLock]")
+{
+	constexpr int iterations = 200000;
+	const int maxThreads = std::max(2, int(std::thread::hardware_concurrency()));
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		benchmark<std::mutex>("std::mutex", numThreads, iterations);
+		benchmark<SpinLock>("SpinLock", numThreads, iterations);
+		benchmark<BackoffSpinLock>("BackoffSpinLock", numThreads, iterations);
+		benchmark<TicketSpinLock>("TicketSpinLock", numThreads, iterations);
+		benchmark<MCSSpinLock>("MCSSpinLock", numThreads, iterations);
+		std::println("");
+	}
+}
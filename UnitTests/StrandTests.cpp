@@ -0,0 +1,149 @@
+#include "crazygaze/core/Strand.h"
+#include "crazygaze/core/ThreadPool.h"
+#include "crazygaze/core/AsyncCommandQueue.h"
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+namespace
+{
+
+template<typename Executor>
+void testStrands(Executor& executor, int numStrands, int numHandlers)
+{
+	struct Data
+	{
+		explicit Data(Executor& executor)
+			: strand(executor)
+		{
+		}
+
+		Strand<Executor> strand;
+		std::atomic<bool> busy = false;
+		std::vector<int> res;
+	};
+
+	std::vector<std::unique_ptr<Data>> strands;
+	for (int i = 0; i < numStrands; i++)
+	{
+		strands.push_back(std::make_unique<Data>(executor));
+	}
+
+	std::atomic<bool> overlapped = false;
+	std::atomic<int> remaining = numStrands * numHandlers;
+	Semaphore done;
+
+	for (int i = 0; i < numHandlers; i++)
+	{
+		for (auto& d : strands)
+		{
+			d->strand.post([&d = *d, i, &overlapped, &remaining, &done]()
+			{
+				if (d.busy.exchange(true))
+					overlapped = true;
+
+				CHECK(d.strand.runningInThisThread());
+				d.res.push_back(i);
+				d.busy = false;
+
+				if (--remaining == 0)
+					done.notify();
+			});
+		}
+	}
+
+	done.wait();
+	CHECK(overlapped == false);
+	for (auto& d : strands)
+	{
+		CHECK(d->strand.runningInThisThread() == false);
+		REQUIRE(d->res.size() == size_t(numHandlers));
+		for (int i = 0; i < numHandlers; i++)
+		{
+			CHECK(d->res[i] == i);
+		}
+	}
+}
+
+} // anonymous namespace
+
+TEST_CASE("Strand", "[Strand]")
+{
+	SECTION("idle size")
+	{
+		CHECK(sizeof(Strand<ThreadPool>) <= 4 * sizeof(void*));
+	}
+
+	SECTION("ThreadPool")
+	{
+		ThreadPool pool(4);
+		testStrands(pool, 1000, 100);
+	}
+
+	SECTION("AsyncCommandQueueAutomatic")
+	{
+		AsyncCommandQueueAutomatic q;
+		testStrands(q, 10, 1000);
+	}
+
+	SECTION("dispatch")
+	{
+		ThreadPool pool(2);
+		Strand<ThreadPool> strand(pool);
+		std::vector<int> res;
+		Semaphore done;
+
+		strand.post([&]()
+		{
+			res.push_back(1);
+			// Runs inline, since we are already in the strand
+			strand.dispatch([&]() { res.push_back(2); });
+			// Queued, and only runs after this handler finishes
+			strand.post([&]()
+			{
+				res.push_back(4);
+				done.notify();
+			});
+			res.push_back(3);
+		});
+
+		done.wait();
+		CHECK((res == std::vector<int>{1, 2, 3, 4}));
+	}
+	SECTION("posting doesn't allocate")
+	{
+		ThreadPool pool(2);
+		Strand<ThreadPool> strand(pool);
+		constexpr int numHandlers = 1000;
+		int count = 0;
+		uint64_t allocs = 0;
+		uint64_t allocsAfter = 0;
+		Semaphore done;
+
+		// Each handler posts the next one, so everything is posted from inside the pool.
+		// The first half warms up the pools.
+		std::function<void()> step = [&]()
+		{
+			count++;
+			if (count == numHandlers / 2)
+			{
+				allocs = getNumAllocations();
+			}
+
+			if (count == numHandlers)
+			{
+				allocsAfter = getNumAllocations();
+				done.notify();
+			}
+			else
+			{
+				strand.post([&step]() { step(); });
+			}
+		};
+
+		strand.post([&step]() { step(); });
+		done.wait();
+		CHECK(allocsAfter == allocs);
+	}
+}
@@ -81,3 +81,16 @@ TEST_CASE("trim_wchar", "[StringUtils]")
 	CHECK(std::wstring( cz::trim(L""))                        == L"");
 }
 
+TEST_CASE("widen", "[StringUtils]")
+{
+	CHECK(cz::widen("Hello \xC3\xA9\xE2\x82\xAC") == L"Hello \u00E9\u20AC");
+	CHECK(cz::widen("") == L"");
+
+	// Converting into an existing string replaces its contents, and doesn't allocate if it has enough capacity
+	std::wstring dst = L"Previous contents, long enough to not fit in the small string buffer";
+	uint64_t allocs = getNumAllocations();
+	cz::widen("Hello", dst);
+	CHECK(getNumAllocations() == allocs);
+	CHECK(dst == L"Hello");
+}
+
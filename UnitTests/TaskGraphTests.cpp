@@ -0,0 +1,125 @@
+#include "crazygaze/core/TaskGraph.h"
+#include "crazygaze/core/ThreadPool.h"
+
+using namespace cz;
+using namespace std::chrono_literals;
+
+TEST_CASE("TaskGraph", "[TaskGraph]")
+{
+	ThreadPool pool(4);
+
+	SECTION("empty")
+	{
+		TaskGraph graph;
+		CHECK(graph.validate());
+		TaskGraph::RunStats stats = graph.run(pool);
+		CHECK(stats.criticalPath.empty());
+	}
+
+	SECTION("dependencies are respected")
+	{
+		// Diamond: a -> (b, c) -> d, run a few times
+		TaskGraph graph;
+		std::atomic<int> counter = 0;
+		int order[4] = {};
+		auto a = graph.add("a", [&]() { order[0] = counter++; });
+		auto b = graph.add("b", [&]() { order[1] = counter++; });
+		auto c = graph.add("c", [&]() { order[2] = counter++; });
+		auto d = graph.add("d", [&]() { order[3] = counter++; });
+		graph.precede(a, b);
+		graph.precede(a, c);
+		graph.succeed(d, {b, c});
+		CHECK(graph.size() == 4);
+		CHECK(graph.getName(c) == "c");
+
+		for (int run = 0; run < 100; run++)
+		{
+			counter = 0;
+			graph.run(pool);
+			CHECK(counter == 4);
+			CHECK(order[0] == 0);
+			CHECK(order[3] == 3);
+		}
+	}
+
+	SECTION("wide and deep")
+	{
+		// Layers of tasks, each task depending on all the tasks of the previous layer
+		constexpr int numLayers = 10;
+		constexpr int width = 30;
+		TaskGraph graph;
+		std::vector<std::atomic<int>> done(numLayers);
+		std::atomic<bool> ok = true;
+		std::vector<TaskGraph::TaskId> previous;
+		for (int layer = 0; layer < numLayers; layer++)
+		{
+			std::vector<TaskGraph::TaskId> current;
+			for (int i = 0; i < width; i++)
+			{
+				auto id = graph.add(std::format("{}_{}", layer, i), [&, layer]()
+				{
+					if (layer > 0 && done[layer - 1].load() != width)
+						ok = false;
+					done[layer]++;
+				});
+
+				for (auto p : previous)
+				{
+					graph.precede(p, id);
+				}
+				current.push_back(id);
+			}
+			previous = std::move(current);
+		}
+
+		for (int run = 0; run < 20; run++)
+		{
+			for (auto& d : done)
+			{
+				d = 0;
+			}
+			graph.run(pool);
+			for (auto& d : done)
+			{
+				CHECK(d == width);
+			}
+		}
+		CHECK(ok);
+	}
+
+	SECTION("critical path")
+	{
+		// a -> slow -> c
+		// a -> fast -> c
+		// independent
+		TaskGraph graph;
+		auto a = graph.add("a", []() { std::this_thread::sleep_for(1ms); });
+		auto slow = graph.add("slow", []() { std::this_thread::sleep_for(20ms); });
+		auto fast = graph.add("fast", []() {});
+		auto c = graph.add("c", []() { std::this_thread::sleep_for(1ms); });
+		graph.add("independent", []() { std::this_thread::sleep_for(5ms); });
+		graph.precede(a, slow);
+		graph.precede(a, fast);
+		graph.succeed(c, {slow, fast});
+
+		TaskGraph::RunStats stats = graph.run(pool);
+		CHECK(stats.criticalPath == (std::vector<TaskGraph::TaskId>{a, slow, c}));
+		CHECK(stats.criticalPathTime >= 22ms);
+		CHECK(stats.totalWork >= stats.criticalPathTime + 5ms);
+		CHECK(stats.wallTime >= stats.criticalPathTime);
+		CHECK(stats.getParallelism() > 1.0);
+	}
+
+	SECTION("cycles")
+	{
+		TaskGraph graph;
+		auto a = graph.add("a", []() {});
+		auto b = graph.add("b", []() {});
+		auto c = graph.add("c", []() {});
+		graph.precede(a, b);
+		graph.precede(b, c);
+		CHECK(graph.validate());
+		graph.precede(c, b);
+		CHECK(graph.validate() == false);
+	}
+}
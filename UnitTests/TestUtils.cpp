@@ -0,0 +1,34 @@
+#include "TestUtils.h"
+
+//
+// Replacing the global operator new/delete so tests can check how many allocations a piece of code does.
+// The array and sized versions of new/delete forward to these by default.
+//
+
+namespace
+{
+	std::atomic<uint64_t> gNumAllocations = 0;
+}
+
+uint64_t getNumAllocations()
+{
+	return gNumAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t n)
+{
+	gNumAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(n ? n : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
@@ -30,3 +30,9 @@ float toMs(Duration d)
 	return std::chrono::duration<float, std::milli>(d).count();
 }
 
+
+/**
+ * Number of times the global operator new was called since the program started, from any thread.
+ * The unit tests replace the global operator new/delete (see TestUtils.cpp) to keep track of this.
+ */
+uint64_t getNumAllocations();
@@ -0,0 +1,173 @@
+#include "crazygaze/core/ThreadPool.h"
+#include "crazygaze/core/PlatformUtils.h"
+#include "crazygaze/core/Semaphore.h"
+#include "TestUtils.h"
+
+using namespace cz;
+
+TEST_CASE("WorkStealingDeque", "[ThreadPool]")
+{
+	SECTION("owner only")
+	{
+		WorkStealingDeque<intptr_t> d(2);
+		for (intptr_t i = 0; i < 100; i++)
+		{
+			d.push(i);
+		}
+		CHECK(d.size() == 100);
+
+		intptr_t v;
+		CHECK(d.steal(v));
+		CHECK(v == 0);
+		for (intptr_t i = 99; i > 0; i--)
+		{
+			CHECK(d.pop(v));
+			CHECK(v == i);
+		}
+		CHECK(d.pop(v) == false);
+		CHECK(d.empty());
+	}
+
+	SECTION("owner and thieves")
+	{
+		constexpr intptr_t count = 200000;
+		WorkStealingDeque<intptr_t> d;
+		std::atomic<int64_t> sum = 0;
+		std::atomic<intptr_t> taken = 0;
+		std::vector<std::thread> thieves;
+		for (int i = 0; i < 3; i++)
+		{
+			thieves.emplace_back([&]()
+			{
+				intptr_t v;
+				while (taken.load() < count)
+				{
+					if (d.steal(v))
+					{
+						sum += v;
+						taken++;
+					}
+				}
+			});
+		}
+
+		intptr_t v;
+		for (intptr_t i = 1; i <= count; i++)
+		{
+			d.push(i);
+			if ((i % 3) == 0 && d.pop(v))
+			{
+				sum += v;
+				taken++;
+			}
+		}
+
+		while (d.pop(v))
+		{
+			sum += v;
+			taken++;
+		}
+
+		for (auto& t : thieves)
+		{
+			t.join();
+		}
+
+		CHECK(taken == count);
+		CHECK(sum == int64_t(count) * (count + 1) / 2);
+	}
+}
+
+TEST_CASE("ThreadPool", "[ThreadPool]")
+{
+	SECTION("defaults to the number of cores")
+	{
+		ThreadPool pool;
+		CHECK(pool.getNumWorkers() == std::max(getNumPhysicalCores(), 1u));
+		CHECK(pool.isWorkerThread() == false);
+	}
+
+	SECTION("executes everything before destruction")
+	{
+		std::atomic<int> count = 0;
+		{
+			ThreadPool pool(4);
+			for (int i = 0; i < 10000; i++)
+			{
+				pool.send([&count]() { count++; });
+			}
+		}
+		CHECK(count == 10000);
+	}
+
+	SECTION("commands sent from workers")
+	{
+		std::atomic<int> count = 0;
+		std::atomic<bool> allInWorkers = true;
+		Semaphore done;
+		ThreadPool pool(4);
+
+		constexpr int numRoots = 100;
+		constexpr int numChildren = 100;
+		std::atomic<int> remaining = numRoots * numChildren;
+		for (int i = 0; i < numRoots; i++)
+		{
+			pool.send([&]()
+			{
+				for (int j = 0; j < numChildren; j++)
+				{
+					pool.send([&]()
+					{
+						if (!pool.isWorkerThread())
+							allInWorkers = false;
+						count++;
+						if (--remaining == 0)
+							done.notify();
+					});
+				}
+			});
+		}
+
+		done.wait();
+		CHECK(count == numRoots * numChildren);
+		CHECK(allInWorkers);
+	}
+	SECTION("commands sent from workers don't allocate")
+	{
+		constexpr int numChildren = 1000;
+		std::atomic<int> remaining = 0;
+		uint64_t allocs = 0;
+		uint64_t allocsAfter = 0;
+		Semaphore done;
+		ThreadPool pool(4);
+
+		pool.send([&]()
+		{
+			auto sendChildren = [&]()
+			{
+				remaining = numChildren;
+				for (int j = 0; j < numChildren; j++)
+				{
+					pool.send([&remaining]() { remaining--; });
+				}
+
+				// Other workers steal the children while we wait
+				while (remaining.load() != 0)
+				{
+					std::this_thread::yield();
+				}
+			};
+
+			// First round grows the worker's deque and the task pool to the size needed
+			sendChildren();
+
+			allocs = getNumAllocations();
+			sendChildren();
+			allocsAfter = getNumAllocations();
+			done.notify();
+		});
+
+		done.wait();
+		CHECK(allocsAfter == allocs);
+	}
+}
@@ -0,0 +1,151 @@
+#include "crazygaze/core/TimerWheel.h"
+#include "TestUtils.h"
+
+using namespace cz;
+using namespace std::chrono_literals;
+
+namespace
+{
+
+// Collects and executes all the due timers, returning the execution order
+std::vector<int> executeDue(TimerWheel& wheel, TimerWheel::Clock::time_point now, std::vector<int>& res)
+{
+	res.clear();
+	wheel.collect(now);
+	TimerId id;
+	Command cmd;
+	while (wheel.popDue(id, cmd))
+	{
+		cmd();
+		wheel.finish(id, std::move(cmd));
+	}
+	return res;
+}
+
+} // anonymous namespace
+
+TEST_CASE("TimerWheel", "[TimerWheel]")
+{
+	const auto start = TimerWheel::Clock::now();
+	TimerWheel wheel(start);
+	std::vector<int> res;
+
+	SECTION("never early")
+	{
+		wheel.add(start + 10ms, {}, [&res]() { res.push_back(1); });
+		// Rounded up to the next millisecond
+		wheel.add(start + 9500us, {}, [&res]() { res.push_back(2); });
+		CHECK(executeDue(wheel, start + 9ms, res).empty());
+		CHECK((executeDue(wheel, start + 10ms, res) == std::vector<int>{1, 2}));
+		CHECK(wheel.size() == 0);
+		CHECK(wheel.getNextWakeUp() == std::nullopt);
+	}
+
+	SECTION("all levels")
+	{
+		// Deadlines in every level of the wheel, including some right at slot boundaries
+		std::vector<int64_t> deadlines = {1, 63, 64, 65, 100, 4095, 4096, 4097, 300000, 262144, 16777216, 16777217};
+		for (int64_t ms : deadlines)
+		{
+			wheel.add(start + std::chrono::milliseconds(ms), {}, [&res, ms]() { res.push_back(int(ms)); });
+		}
+
+		std::sort(deadlines.begin(), deadlines.end());
+		std::vector<int> all;
+		auto now = start;
+		while (wheel.size())
+		{
+			// Jump straight to when the wheel asks us to, like AsyncCommandQueue does
+			auto wakeUp = wheel.getNextWakeUp();
+			REQUIRE(wakeUp);
+			REQUIRE(*wakeUp > now);
+			now = *wakeUp;
+			for (int v : executeDue(wheel, now, res))
+			{
+				// Executed exactly at the deadline
+				CHECK(std::chrono::milliseconds(v) == now - start);
+				all.push_back(v);
+			}
+		}
+
+		CHECK(all.size() == deadlines.size());
+		CHECK(std::equal(all.begin(), all.end(), deadlines.begin()));
+	}
+
+	SECTION("big jumps")
+	{
+		wheel.add(start + 70000ms, {}, [&res]() { res.push_back(1); });
+		wheel.add(start + 5ms, {}, [&res]() { res.push_back(2); });
+		CHECK((executeDue(wheel, start + 69999ms, res) == std::vector<int>{2}));
+		CHECK((executeDue(wheel, start + 100000ms, res) == std::vector<int>{1}));
+	}
+
+	SECTION("cancel")
+	{
+		TimerId a = wheel.add(start + 10ms, {}, [&res]() { res.push_back(1); });
+		TimerId b = wheel.add(start + 5000ms, {}, [&res]() { res.push_back(2); });
+		wheel.add(start + 10ms, {}, [&res]() { res.push_back(3); });
+		CHECK(wheel.cancel(a));
+		CHECK(wheel.cancel(b));
+		CHECK(!wheel.cancel(b));
+		CHECK(wheel.size() == 1);
+		CHECK((executeDue(wheel, start + 10s, res) == std::vector<int>{3}));
+
+		// Ids of freed timers are not valid anymore, even if the slot is reused
+		TimerId c = wheel.add(start + 11s, {}, [&res]() { res.push_back(4); });
+		CHECK(c != a);
+		CHECK(!wheel.cancel(a));
+		CHECK(wheel.cancel(c));
+	}
+
+	SECTION("cancel from the timer itself")
+	{
+		TimerId id;
+		id = wheel.add(start + 10ms, 10ms, [&]()
+		{
+			res.push_back(1);
+			CHECK(!wheel.cancel(id));
+		});
+		CHECK((executeDue(wheel, start + 10ms, res) == std::vector<int>{1}));
+		CHECK(wheel.size() == 0);
+	}
+
+	SECTION("periodic")
+	{
+		int count = 0;
+		TimerId id = wheel.add(start + 10ms, 10ms, [&count]() { count++; });
+		executeDue(wheel, start + 10ms, res);
+		CHECK(count == 1);
+		executeDue(wheel, start + 19ms, res);
+		CHECK(count == 1);
+		executeDue(wheel, start + 20ms, res);
+		CHECK(count == 2);
+
+		// Falling behind skips the missed executions, but keeps the original schedule
+		executeDue(wheel, start + 75ms, res);
+		CHECK(count == 3);
+		CHECK(wheel.getNextWakeUp() == start + 80ms);
+
+		CHECK(wheel.cancel(id));
+		CHECK(wheel.size() == 0);
+	}
+
+	SECTION("collect only counts the due list")
+	{
+		TimerId a = wheel.add(start + 10ms, {}, []() {});
+		TimerId b = wheel.add(start + 10ms, {}, []() {});
+		wheel.add(start + 20ms, {}, []() {});
+		CHECK(wheel.collect(start + 10ms) == 2);
+
+		// Timers being executed are not due anymore, so whoever is ticking the wheel can sleep until the next one
+		TimerId id;
+		Command cmd;
+		REQUIRE(wheel.popDue(id, cmd));
+		CHECK(id == a);
+		CHECK(wheel.collect(start + 10ms) == 1);
+		CHECK(wheel.cancel(b));
+		CHECK(wheel.collect(start + 10ms) == 0);
+		wheel.finish(id, std::move(cmd));
+		CHECK(wheel.size() == 1);
+	}
+}
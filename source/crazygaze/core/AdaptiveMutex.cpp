@@ -0,0 +1,60 @@
+#include "AdaptiveMutex.h"
+#include "ThreadingUtils.h"
+
+namespace cz
+{
+
+void AdaptiveMutex::lockSlow() noexcept
+{
+	const uint32_t limit = getSpinEstimate();
+	for (uint32_t i = 0; i < limit; i++)
+	{
+		emitPause();
+		uint32_t state = m_state.load(std::memory_order_relaxed);
+		if ((state & LockMask) == Unlocked &&
+			m_state.compare_exchange_weak(state, state | Locked, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			// Spinning paid off, so move the estimate towards twice what it took, so it can handle a bit more variance.
+			setSpinEstimate(uint32_t(int32_t(limit) + (int32_t(i * 2) - int32_t(limit)) / 8));
+			return;
+		}
+	}
+
+	// Block until we get the lock.
+	// Once we block, we can't know if there are other threads blocked, so we always mark the lock as Contended, so that
+	// `unlock` wakes up the next thread.
+	uint32_t state = m_state.load(std::memory_order_relaxed);
+	while (true)
+	{
+		const uint32_t contended = (state & ~LockMask) | Contended;
+		if (m_state.compare_exchange_weak(state, contended, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			if ((state & LockMask) == Unlocked)
+				break;
+
+			futexWait(m_state, contended);
+			state = m_state.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Spinning was a waste of time, so spin less next time
+	setSpinEstimate(limit / 2);
+}
+
+void AdaptiveMutex::setSpinEstimate(uint32_t estimate) noexcept
+{
+	// Only the lock owner changes the estimate, and other threads only change the lock bits, so we can apply the difference with
+	// a single atomic add/sub, without touching the lock bits.
+	estimate = std::clamp(estimate, MinSpin, MaxSpin);
+	const uint32_t current = getSpinEstimate();
+	if (estimate > current)
+	{
+		m_state.fetch_add((estimate - current) << SpinShift, std::memory_order_relaxed);
+	}
+	else if (estimate < current)
+	{
+		m_state.fetch_sub((current - estimate) << SpinShift, std::memory_order_relaxed);
+	}
+}
+
+} // namespace cz
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Common.h"
+#include "Futex.h"
+
+namespace cz
+{
+
+/**
+ * Mutex for critical sections that are usually short, but occasionally long.
+ *
+ * - When it's contended, `lock` first spins for a while (like SpinLock), and only then blocks on a futex (like std::mutex).
+ * - How long it spins adapts to how long the lock is usually held: if spinning pays off, it spins up to about twice what it took
+ *   last time, and if it doesn't, it spins less next time.
+ * - The entire state (lock state + spin estimate) fits in a single 32-bit word, so it can be embedded in small objects.
+ *
+ * The lock part of the state is the classic 3 state futex mutex from Ulrich Drepper's "Futexes Are Tricky", so `unlock` only
+ * makes a syscall if there might be threads blocked.
+ *
+ * Same interface as std::mutex, so it can be used with std::lock_guard, std::unique_lock and Monitor.
+ */
+class AdaptiveMutex
+{
+  public:
+	AdaptiveMutex() = default;
+	CZ_DELETE_COPY_AND_MOVE(AdaptiveMutex);
+
+	void lock() noexcept
+	{
+		// Fast path (uncontended)
+		uint32_t state = m_state.load(std::memory_order_relaxed);
+		if ((state & LockMask) == Unlocked &&
+			m_state.compare_exchange_weak(state, state | Locked, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			return;
+		}
+
+		lockSlow();
+	}
+
+	bool try_lock() noexcept
+	{
+		uint32_t state = m_state.load(std::memory_order_relaxed);
+		while ((state & LockMask) == Unlocked)
+		{
+			if (m_state.compare_exchange_weak(state, state | Locked, std::memory_order_acquire, std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		uint32_t old = m_state.fetch_and(~LockMask, std::memory_order_release);
+		if ((old & LockMask) == Contended)
+		{
+			futexWakeOne(m_state);
+		}
+	}
+
+	/**
+	 * Current number of iterations `lock` spins for before blocking. Only useful for tests and diagnostics.
+	 */
+	uint32_t getSpinEstimate() const
+	{
+		return m_state.load(std::memory_order_relaxed) >> SpinShift;
+	}
+
+  private:
+
+	void lockSlow() noexcept;
+	// Changes the spin estimate. Must only be called while holding the lock
+	void setSpinEstimate(uint32_t estimate) noexcept;
+
+	// Lowest 2 bits: lock state
+	static constexpr uint32_t Unlocked = 0;
+	static constexpr uint32_t Locked = 1;
+	// Locked, and there might be threads blocked
+	static constexpr uint32_t Contended = 2;
+	static constexpr uint32_t LockMask = 3;
+
+	// Remaining bits: spin estimate
+	static constexpr uint32_t SpinShift = 2;
+	static constexpr uint32_t MinSpin = 16;
+	static constexpr uint32_t MaxSpin = 4096;
+	static constexpr uint32_t InitialSpin = 128;
+
+	// This is also the futex word
+	std::atomic<uint32_t> m_state = InitialSpin << SpinShift;
+};
+
+static_assert(sizeof(AdaptiveMutex) == sizeof(uint32_t));
+
+} // namespace cz
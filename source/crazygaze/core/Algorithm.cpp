@@ -0,0 +1,107 @@
+#include "Algorithm.h"
+#include "Futex.h"
+#include "PlatformUtils.h"
+#include "ThreadPool.h"
+#include "ThreadingUtils.h"
+
+namespace cz::details
+{
+
+namespace
+{
+	// How many chunks to create per thread, so threads that finish early can pick up more work
+	constexpr size_t ChunksPerThread = 4;
+
+	ThreadPool& getPool()
+	{
+		// The calling thread helps, so one less worker than cores
+		static ThreadPool pool(std::max(getNumPhysicalCores(), 2u) - 1);
+		return pool;
+	}
+
+	/**
+	 * State shared by all the threads working on a parallelRun call.
+	 * It's reference counted, because helpers that only start once all the work is done still look at it (and find nothing to
+	 * do), and the caller doesn't wait for those.
+	 */
+	struct RunState
+	{
+		void (*fn)(void*, size_t);
+		void* ctx;
+		size_t numChunks;
+		std::atomic<size_t> next = 0;
+		// Chunks not finished yet
+		std::atomic<uint32_t> remaining;
+
+		void work()
+		{
+			while (true)
+			{
+				const size_t index = next.fetch_add(1, std::memory_order_relaxed);
+				if (index >= numChunks)
+					return;
+
+				fn(ctx, index);
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					futexWakeAll(remaining);
+			}
+		}
+	};
+
+} // anonymous namespace
+
+uint32_t getParallelism()
+{
+	return getPool().getNumWorkers() + 1;
+}
+
+size_t calcNumChunks(size_t count, size_t elementSize, size_t grainSize, size_t& chunkSize)
+{
+	if (count == 0)
+	{
+		chunkSize = 0;
+		return 0;
+	}
+
+	if (grainSize == 0)
+	{
+		grainSize = std::max(ParallelSequentialCutoff, count / (getParallelism() * ChunksPerThread));
+
+		// Round up to a whole number of cache lines
+		const size_t perCacheLine = std::max<size_t>(1, CacheLineSize / std::max<size_t>(1, elementSize));
+		grainSize = (grainSize + perCacheLine - 1) / perCacheLine * perCacheLine;
+	}
+
+	// An explicit grain size is not rounded, since the caller knows better how expensive each element is
+	chunkSize = std::min(grainSize, count);
+	return (count + chunkSize - 1) / chunkSize;
+}
+
+void parallelRun(size_t numChunks, void (*fn)(void* ctx, size_t chunkIndex), void* ctx)
+{
+	CZ_CHECK(numChunks <= UINT32_MAX);
+	auto state = std::make_shared<RunState>();
+	state->fn = fn;
+	state->ctx = ctx;
+	state->numChunks = numChunks;
+	state->remaining.store(static_cast<uint32_t>(numChunks), std::memory_order_relaxed);
+
+	ThreadPool& pool = getPool();
+	const size_t numHelpers = std::min<size_t>(numChunks - 1, pool.getNumWorkers());
+	for (size_t i = 0; i < numHelpers; i++)
+	{
+		pool.send([state]() { state->work(); });
+	}
+
+	state->work();
+
+	// Wait for the chunks other threads are still working on. We don't wait for helpers that didn't start yet, which also
+	// means nested calls from inside the pool can't deadlock.
+	uint32_t remaining;
+	while ((remaining = state->remaining.load(std::memory_order_acquire)) != 0)
+	{
+		futexWait(state->remaining, remaining);
+	}
+}
+
+} // namespace cz::details
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include "Logging.h"
+
 namespace cz
 {
 	/*
@@ -148,5 +150,207 @@ namespace cz
 		return false;
 	}
 
-} // namespace cz
+	//////////////////////////////////////////////////////////////////////////
+	//	Parallel algorithms
+	//
+	//	They split the range into chunks that are executed by an internal ThreadPool (created on first use, and sized from
+	//	`getNumPhysicalCores()`), with the calling thread helping out. All of them block until the work is done, so they can
+	//	be used with references to local state. They can also be called from inside other parallel algorithms.
+	//
+	//	Unless a grain size (minimum number of elements per chunk) is specified, it's calculated from the range size, so that:
+	//	- Small ranges (up to `ParallelSequentialCutoff` elements) run sequentially on the calling thread, since splitting them
+	//	  costs more than what it saves
+	//	- There are a few chunks per thread, so threads that finish early can pick up more work
+	//	- Chunk sizes are a multiple of a cache line's worth of elements, so threads don't write to the same cache lines
+	//
+	//	The automatic grain size only looks at the number of elements, and assumes the work per element is cheap. If it isn't
+	//	(e.g: each element is a whole job), pass a grain size. An explicit grain size is used as is, down to 1 element per chunk.
+	//////////////////////////////////////////////////////////////////////////
+
+	/**
+	 * Ranges up to this many elements run sequentially on the calling thread, unless a grain size is specified.
+	 */
+	inline constexpr size_t ParallelSequentialCutoff = 2048;
+
+	namespace details
+	{
+		/**
+		 * Runs `fn(ctx, chunkIndex)` for every chunkIndex in [0, numChunks), with the calling thread helping.
+		 * Returns once all chunks are done.
+		 */
+		void parallelRun(size_t numChunks, void (*fn)(void* ctx, size_t chunkIndex), void* ctx);
+
+		/**
+		 * Number of threads that parallel algorithms use (pool workers plus the calling thread)
+		 */
+		uint32_t getParallelism();
+
+		/**
+		 * Calculates how to split `count` elements in chunks.
+		 * @param elementSize Size of the elements being written, to align automatically calculated chunks to cache lines
+		 * @param grainSize Minimum number of elements per chunk. If 0, it's calculated automatically, otherwise it's used as is.
+		 * @param chunkSize Receives the number of elements per chunk (the last chunk can be smaller)
+		 * @return Number of chunks
+		 */
+		size_t calcNumChunks(size_t count, size_t elementSize, size_t grainSize, size_t& chunkSize);
+
+		/**
+		 * Calls `f(begin, end)` for chunks of the [0, count) range, in parallel, with chunks as calculated by `calcNumChunks`.
+		 */
+		template<typename F>
+		void runChunks(size_t count, size_t chunkSize, size_t numChunks, F&& f)
+		{
+			if (numChunks <= 1)
+			{
+				if (count)
+					f(size_t(0), count);
+				return;
+			}
+
+			struct Ctx
+			{
+				F& f;
+				size_t count;
+				size_t chunkSize;
+			} ctx{f, count, chunkSize};
+
+			parallelRun(numChunks, [](void* p, size_t chunkIndex)
+			{
+				auto& c = *static_cast<Ctx*>(p);
+				const size_t begin = chunkIndex * c.chunkSize;
+				c.f(begin, std::min(begin + c.chunkSize, c.count));
+			}, &ctx);
+		}
+
+		/**
+		 * Calls `f(begin, end)` for chunks of the [0, count) range, in parallel.
+		 */
+		template<typename F>
+		void parallelChunks(size_t count, size_t elementSize, size_t grainSize, F&& f)
+		{
+			size_t chunkSize;
+			const size_t numChunks = calcNumChunks(count, elementSize, grainSize, chunkSize);
+			runChunks(count, chunkSize, numChunks, std::forward<F>(f));
+		}
+
+	} // namespace details
+
+	/**
+	 * Calls `f(i)` for every i in [begin, end), in parallel.
+	 */
+	template<std::integral Index, typename F>
+	void parallel_for(Index begin, Index end, F&& f, size_t grainSize = 0)
+	{
+		if (end <= begin)
+			return;
+
+		details::parallelChunks(static_cast<size_t>(end - begin), 1, grainSize, [begin, &f](size_t chunkBegin, size_t chunkEnd)
+		{
+			for (size_t i = chunkBegin; i < chunkEnd; i++)
+				f(static_cast<Index>(begin + static_cast<Index>(i)));
+		});
+	}
+
+	/**
+	 * Calls `f(element)` for every element of the range, in parallel.
+	 */
+	template<std::ranges::random_access_range R, typename F>
+	void parallel_for_each(R&& range, F&& f, size_t grainSize = 0)
+	{
+		auto first = std::ranges::begin(range);
+		const size_t count = static_cast<size_t>(std::ranges::distance(range));
+		details::parallelChunks(count, sizeof(std::ranges::range_value_t<R>), grainSize, [first, &f](size_t chunkBegin, size_t chunkEnd)
+		{
+			for (auto it = first + chunkBegin, end = first + chunkEnd; it != end; ++it)
+				f(*it);
+		});
+	}
+
+	/**
+	 * Sets `out[i] = f(in[i])` for every element of `in`, in parallel.
+	 * `out` must have at least as many elements as `in`, and can be the same range.
+	 */
+	template<std::ranges::random_access_range In, std::ranges::random_access_range Out, typename F>
+	void parallel_transform(In&& in, Out&& out, F&& f, size_t grainSize = 0)
+	{
+		const size_t count = static_cast<size_t>(std::ranges::distance(in));
+		CZ_CHECK(static_cast<size_t>(std::ranges::distance(out)) >= count);
+		auto src = std::ranges::begin(in);
+		auto dst = std::ranges::begin(out);
+		details::parallelChunks(count, sizeof(std::ranges::range_value_t<Out>), grainSize, [src, dst, &f](size_t chunkBegin, size_t chunkEnd)
+		{
+			for (size_t i = chunkBegin; i < chunkEnd; i++)
+				dst[i] = f(src[i]);
+		});
+	}
+
+	/**
+	 * Reduces the range with `op`, in parallel.
+	 * Like std::reduce, `op` must be associative, since each chunk is reduced separately and the results are then combined (in
+	 * order, so `op` doesn't need to be commutative).
+	 *
+	 * @param transform Applied to each element before reducing (e.g: to sum the squares of the elements)
+	 */
+	template<std::ranges::random_access_range R, typename T, typename Op = std::plus<>, typename Transform = std::identity>
+	T parallel_reduce(R&& range, T init, Op op = {}, Transform transform = {}, size_t grainSize = 0)
+	{
+		const size_t count = static_cast<size_t>(std::ranges::distance(range));
+		auto first = std::ranges::begin(range);
+
+		size_t chunkSize;
+		const size_t numChunks = details::calcNumChunks(count, 1, grainSize, chunkSize);
+
+		// Each chunk only writes its result once, at the end, so there is no point in padding these to avoid false sharing
+		std::vector<std::optional<T>> partials(numChunks);
+
+		details::runChunks(count, chunkSize, numChunks, [&](size_t chunkBegin, size_t chunkEnd)
+		{
+			auto it = first + chunkBegin;
+			const auto end = first + chunkEnd;
+			T acc = transform(*it);
+			for (++it; it != end; ++it)
+				acc = op(std::move(acc), transform(*it));
+			partials[chunkBegin / chunkSize] = std::move(acc);
+		});
 
+		for (std::optional<T>& partial : partials)
+		{
+			init = op(std::move(init), std::move(*partial));
+		}
+		return init;
+	}
+
+	/**
+	 * Sorts the range in parallel.
+	 * Chunks are sorted in parallel with std::sort, and then adjacent chunks are merged in pairs (also in parallel) until there
+	 * is only one left. Like std::sort, it's not stable.
+	 */
+	template<std::ranges::random_access_range R, typename Compare = std::ranges::less>
+	void parallel_sort(R&& range, Compare comp = {}, size_t grainSize = 0)
+	{
+		auto first = std::ranges::begin(range);
+		const size_t count = static_cast<size_t>(std::ranges::distance(range));
+
+		size_t chunkSize;
+		const size_t numChunks = details::calcNumChunks(count, sizeof(std::ranges::range_value_t<R>), grainSize, chunkSize);
+		details::runChunks(count, chunkSize, numChunks, [&](size_t chunkBegin, size_t chunkEnd)
+		{
+			std::sort(first + chunkBegin, first + chunkEnd, comp);
+		});
+
+		// Merge adjacent sorted runs, doubling the run size on every pass
+		for (size_t runSize = chunkSize; runSize < count; runSize *= 2)
+		{
+			const size_t numMerges = (count + 2 * runSize - 1) / (2 * runSize);
+			parallel_for(size_t(0), numMerges, [&](size_t i)
+			{
+				const size_t begin = i * 2 * runSize;
+				const size_t middle = std::min(begin + runSize, count);
+				const size_t end = std::min(begin + 2 * runSize, count);
+				if (middle < end)
+					std::inplace_merge(first + begin, first + middle, first + end, comp);
+			}, 1);
+		}
+	}
+
+} // namespace cz
@@ -12,63 +12,355 @@
 namespace cz
 {
 
-void AsyncCommandQueue::send(std::function<void()>&& f)
+void AsyncCommandQueue::send(Command&& f, CommandPriority priority)
 {
 	CZ_CHECK(f);
-	m_queue.push(std::move(f));
+	checkLazyStart();
+	getLane(priority).push(std::move(f));
+	m_event.notifyOne();
+}
+
+void AsyncCommandQueue::setLaneBudget(CommandPriority priority, size_t budget)
+{
+	CZ_CHECK(budget > 0);
+	m_budgets[static_cast<size_t>(priority)] = budget;
+}
+
+void AsyncCommandQueue::setStats(QueueStats* stats)
+{
+	for (WorkQueue& lane : m_lanes)
+	{
+		lane.setStats(stats);
+	}
+	m_stats = stats;
+}
+
+void AsyncCommandQueue::execute(Command& f)
+{
+	if (!m_stats)
+	{
+		f();
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	f();
+	m_stats->recordExecTime(std::chrono::steady_clock::now() - start);
+}
+
+size_t AsyncCommandQueue::calcLaneSizes(size_t (&sizes)[NumCommandPriorities]) const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < NumCommandPriorities; i++)
+	{
+		sizes[i] = m_lanes[i].size();
+		total += sizes[i];
+	}
+	return total;
+}
+
+TimerId AsyncCommandQueue::addTimer(TimerWheel::Clock::time_point point, TimerWheel::Clock::duration period, Command&& f)
+{
+	CZ_CHECK(f);
+	checkLazyStart();
+	TimerId id;
+	{
+		std::lock_guard lk(m_timersMtx);
+		id = m_timers.add(point, period, std::move(f));
+		m_timersVersion.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// The new timer might be due before whatever the consumer is sleeping for
+	m_event.notifyOne();
+	return id;
+}
+
+bool AsyncCommandQueue::cancelTimer(TimerId id)
+{
+	std::lock_guard lk(m_timersMtx);
+	return m_timers.cancel(id);
 }
 
-void AsyncCommandQueue::tickImpl(bool wait)
+size_t AsyncCommandQueue::collectTimers()
+{
+	std::lock_guard lk(m_timersMtx);
+	if (m_timers.size() == 0)
+		return 0;
+	return m_timers.collect(TimerWheel::Clock::now());
+}
+
+size_t AsyncCommandQueue::executeTimers()
+{
+	// The lock is not held while executing the commands, so they can add or cancel timers.
+	// Only the timers that were already in the due list are executed, since nothing else calls `collect`.
+	size_t executed = 0;
+	TimerId id;
+	Command f;
+	while (true)
+	{
+		{
+			std::lock_guard lk(m_timersMtx);
+			if (executed)
+				m_timers.finish(id, std::move(f));
+			if (!m_timers.popDue(id, f))
+				break;
+		}
+
+		execute(f);
+		executed++;
+	}
+
+	return executed;
+}
+
+void AsyncCommandQueue::waitForWork()
+{
+	// Reading the version before calculating when to wake up, so if a timer is added after this, the predicate sees it
+	const uint32_t version = m_timersVersion.load(std::memory_order_relaxed);
+	std::optional<TimerWheel::Clock::time_point> wakeUp;
+	{
+		std::lock_guard lk(m_timersMtx);
+		wakeUp = m_timers.getNextWakeUp();
+	}
+
+	size_t sizes[NumCommandPriorities];
+	auto pred = [&]()
+	{
+		return calcLaneSizes(sizes) != 0 || m_timersVersion.load(std::memory_order_relaxed) != version || isStopRequested();
+	};
+
+	if (wakeUp)
+		m_event.waitUntil(*wakeUp, pred);
+	else
+		m_event.wait(pred);
+}
+
+size_t AsyncCommandQueue::tickImpl(bool wait)
 {
 	// Instead of having a possible infinite loop (if we get commands faster than we can process them),
 	// I'm checking how many items we have at the start then only consume those.
-	size_t todo = m_queue.size();
+	size_t todo[NumCommandPriorities];
+	size_t total = calcLaneSizes(todo);
+	size_t dueTimers = collectTimers();
 
-	// If nothing to do, we wait until there is something
-	if (todo==0 && wait)
+	// If nothing to do, we wait until there is something.
+	// This sleeps until the next timer is due or a command arrives, whatever comes first. Waking up doesn't necessarily mean
+	// there is something to do (e.g: a timer was added, or a timer needs to move to a lower level of the wheel), hence the loop.
+	while (total == 0 && dueTimers == 0 && wait && !isStopRequested())
 	{
-		std::function<void()> f = m_queue.waitAndPop();
-		f();
-		todo = m_queue.size();
+		waitForWork();
+		total = calcLaneSizes(todo);
+		dueTimers = collectTimers();
 	}
 
-	while (todo--)
+	size_t executed = dueTimers ? executeTimers() : 0;
+	for (size_t i = 0; i < NumCommandPriorities; i++)
 	{
-		std::function<void()> f;
-		CZ_VERIFY(m_queue.tryAndPop(f));
-		f();
+		size_t count = std::min(todo[i], m_budgets[i]);
+		while (count--)
+		{
+			// With more than one thread ticking the queue, others might have popped the commands already
+			Command f;
+			if (!m_lanes[i].tryAndPop(f))
+				break;
+			execute(f);
+			executed++;
+		}
 	}
+
+	return executed;
+}
+
+void AsyncCommandQueue::requestStop()
+{
+	m_stopRequested.store(true, std::memory_order_release);
+	m_event.notifyAll();
 }
 
 //////////////////////////////////////////////////////////////////////////
 //	AsyncCommandQueueExplicit
 //////////////////////////////////////////////////////////////////////////
-void AsyncCommandQueueExplicit::tick(bool wait)
+size_t AsyncCommandQueueExplicit::tick(bool wait)
 {
-	tickImpl(wait);
+	return tickImpl(wait);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //	AsyncCommandQueueAutomatic
 //////////////////////////////////////////////////////////////////////////
 AsyncCommandQueueAutomatic::AsyncCommandQueueAutomatic()
+	: AsyncCommandQueueAutomatic(Options())
+{
+}
+
+AsyncCommandQueueAutomatic::AsyncCommandQueueAutomatic(Options options)
+	: m_options(std::move(options))
 {
-	m_thread = std::thread(&AsyncCommandQueueAutomatic::run, this);
+	CZ_CHECK(m_options.numWorkers > 0);
+	if (m_options.lazyStart)
+	{
+		m_lazyStartPending.store(true, std::memory_order_release);
+	}
+	else
+	{
+		start();
+	}
 }
 
 AsyncCommandQueueAutomatic::~AsyncCommandQueueAutomatic()
 {
-	m_queue.push( [this]() { m_finish = true; }) ;
+	// Nothing was ever sent, so there are no threads to stop
+	if (!isStarted())
+		return;
+
+	// Using the lowest priority, so everything sent before this is executed
+	send([this]() { requestStop(); }, CommandPriority::Low);
+	for (auto& t : m_threads)
+	{
+		t.join();
+	}
+}
+
+void AsyncCommandQueueAutomatic::lazyStart()
+{
+	start();
+}
+
+void AsyncCommandQueueAutomatic::start()
+{
+	std::call_once(m_startFlag, [this]()
+	{
+		m_threads.reserve(m_options.numWorkers);
+		for (uint32_t i = 0; i < m_options.numWorkers; i++)
+		{
+			m_threads.emplace_back(&AsyncCommandQueueAutomatic::run, this, i);
+		}
+		m_lazyStartPending.store(false, std::memory_order_release);
+	});
+}
+
+void AsyncCommandQueueAutomatic::run(uint32_t index)
+{
+	if (!m_options.threadName.empty())
+	{
+		setCurrentThreadName(
+			m_options.numWorkers > 1 ? std::format("{}{}", m_options.threadName, index) : m_options.threadName);
+	}
+
+	if (m_options.affinityMask && !setCurrentThreadAffinity(m_options.affinityMask))
+	{
+		CZ_LOG(Main, Warning, "Failed to set affinity mask {:#x} for AsyncCommandQueueAutomatic worker", m_options.affinityMask);
+	}
+
+	if (m_options.priority != ThreadPriority::Normal && !setCurrentThreadPriority(m_options.priority))
+	{
+		CZ_LOG(Main, Warning, "Failed to set priority {} for AsyncCommandQueueAutomatic worker", static_cast<int>(m_options.priority));
+	}
+
+	while (!isStopRequested())
+	{
+		tickImpl(true);
+	}
+
+	// Anything left behind because of lane budgets, or sent while stopping
+	while (tickImpl(false))
+	{
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+//	AsyncCommandQueueSPSC
+//////////////////////////////////////////////////////////////////////////
+AsyncCommandQueueSPSC::AsyncCommandQueueSPSC(size_t capacity)
+	: m_queue(capacity)
+{
+	m_thread = std::thread(&AsyncCommandQueueSPSC::run, this);
+}
+
+AsyncCommandQueueSPSC::~AsyncCommandQueueSPSC()
+{
+	send([this]() { m_finish = true; });
 	m_thread.join();
 }
 
-void AsyncCommandQueueAutomatic::run()
+void AsyncCommandQueueSPSC::send(Command&& f)
 {
+	CZ_CHECK(f);
+	m_queue.push(std::move(f));
+
+	// Pairs with the fence in `run`. Either we see the consumer is parked, or the consumer sees the command we just pushed.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_relaxed))
+	{
+		m_wakeup.notify();
+	}
+}
+
+void AsyncCommandQueueSPSC::run()
+{
+	int spins = 0;
 	while (!m_finish)
 	{
-		tickImpl(true);
+		if (Command* f = m_queue.front())
+		{
+			(*f)();
+			m_queue.pop();
+			spins = 0;
+			continue;
+		}
+
+		if (spins < SpinCount)
+		{
+			spins++;
+			emitPause();
+			continue;
+		}
+
+		// Nothing to do for a while, so park the thread
+		m_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_queue.empty())
+		{
+			m_wakeup.wait();
+		}
+		else if (!m_sleeping.exchange(false, std::memory_order_relaxed))
+		{
+			// A producer already saw we were parked and notified (or is about to), so we need to consume that notification
+			m_wakeup.wait();
+		}
+		spins = 0;
 	}
 }
 
-} // namespace cz
+//////////////////////////////////////////////////////////////////////////
+//	AsyncCommandQueueBuffered
+//////////////////////////////////////////////////////////////////////////
+AsyncCommandQueueBuffered::AsyncCommandQueueBuffered(size_t chunkCapacity)
+	: m_buffers{CommandVector(chunkCapacity), CommandVector(chunkCapacity)}
+	, m_back(&m_buffers[0])
+	, m_front(&m_buffers[1])
+{
+}
 
+size_t AsyncCommandQueueBuffered::tick(bool wait)
+{
+	{
+		std::unique_lock lk(m_mtx);
+		if (wait)
+		{
+			m_waiting = true;
+			m_cv.wait(lk, [this] { return m_back->size() != 0; });
+			m_waiting = false;
+		}
+		std::swap(m_back, m_front);
+	}
+
+	size_t count = m_front->executeAll();
+
+	// If the batch needed more than one chunk, this consolidates it into a single chunk big enough for a similar batch.
+	// Otherwise it just keeps the existing chunk, so steady state recording doesn't allocate.
+	m_front->clear(m_front->calcCapacity());
+	return count;
+}
+
+} // namespace cz
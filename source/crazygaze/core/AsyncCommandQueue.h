@@ -1,11 +1,31 @@
 #pragma once
 
 #include "Common.h"
+#include "Future.h"
+#include "PlatformUtils.h"
+#include "PolyChunkVector.h"
 #include "SharedQueue.h"
+#include "SPSCQueue.h"
+#include "Semaphore.h"
+#include "ThreadingUtils.h"
+#include "TimerWheel.h"
 
 namespace cz
 {
 
+/**
+ * Priority lanes of an AsyncCommandQueue.
+ * When ticking, higher priority lanes are executed first.
+ */
+enum class CommandPriority : uint8_t
+{
+	High,
+	Normal,
+	Low
+};
+
+inline constexpr size_t NumCommandPriorities = 3;
+
 class AsyncCommandQueue
 {
 public:
@@ -15,20 +35,150 @@ public:
 	AsyncCommandQueue& operator=(const AsyncCommandQueue&) = delete; 
 
 	// To be called by any thread that wishes to send commands to the queue
-	void send( std::function<void()>&& f);
+	void send(Command&& f, CommandPriority priority = CommandPriority::Normal);
+
+	// Same as `send`, but returns a future for the command's result. See Future::then to chain commands without blocking
+	template<typename F>
+	auto sendWithResult(F&& f, CommandPriority priority = CommandPriority::Normal)
+	{
+		struct Lane
+		{
+			AsyncCommandQueue& q;
+			CommandPriority priority;
+			void send(Command&& f)
+			{
+				q.send(std::move(f), priority);
+			}
+		};
 
-	WorkQueue& getQueue()
+		Lane lane{*this, priority};
+		return cz::sendWithResult(lane, std::forward<F>(f));
+	}
+
+	/**
+	 * Sets the maximum number of commands executed from the specified lane per tick.
+	 * By default there is no limit.
+	 *
+	 * This is useful to stop bursts of low priority commands from making a tick take too long. Since the budget can't be 0, no
+	 * lane ever starves.
+	 * Should only be called from the thread that ticks the queue, or before it starts ticking.
+	 */
+	void setLaneBudget(CommandPriority priority, size_t budget);
+
+	/**
+	 * Executes a command once the specified time elapses.
+	 * Timers have 1ms resolution, and are never executed early. See TimerWheel.
+	 * Can be called from any thread.
+	 *
+	 * \return An id that can be used to cancel the timer with `cancelTimer`
+	 */
+	template<typename Rep, typename Period>
+	TimerId sendAfter(std::chrono::duration<Rep, Period> delay, Command&& f)
 	{
-		return m_queue;
+		return addTimer(TimerWheel::Clock::now() + std::chrono::ceil<TimerWheel::Clock::duration>(delay), {}, std::move(f));
 	}
 
+	// Same as `sendAfter`, but at a specific point in time
+	TimerId sendAt(TimerWheel::Clock::time_point point, Command&& f)
+	{
+		return addTimer(point, {}, std::move(f));
+	}
+
+	/**
+	 * Executes a command repeatedly, every `period`, starting `period` from now.
+	 * Executions are scheduled from the original start time, so they don't drift. If the queue falls behind, missed executions
+	 * are skipped instead of executed in a burst.
+	 */
+	template<typename Rep, typename Period>
+	TimerId sendEvery(std::chrono::duration<Rep, Period> period, Command&& f)
+	{
+		auto p = std::chrono::ceil<TimerWheel::Clock::duration>(period);
+		CZ_CHECK(p.count() > 0);
+		return addTimer(TimerWheel::Clock::now() + p, p, std::move(f));
+	}
+
+	/**
+	 * Cancels a timer created with `sendAfter`, `sendAt` or `sendEvery`.
+	 * \return True if the timer was cancelled before executing. False if it doesn't exist anymore, or is executing right now.
+	 * Periodic timers are always stopped, even if cancelled while executing.
+	 */
+	bool cancelTimer(TimerId id);
+
+	/**
+	 * Enables instrumentation for all the lanes, or disables it if null. See QueueStats.
+	 * Besides what SharedQueue tracks, this also tracks how long each command takes to execute (timers included).
+	 * Should be called before any commands are sent. `stats` must outlive the queue (or until instrumentation is disabled).
+	 */
+	void setStats(QueueStats* stats);
+
 protected:
 	/*!
-	 * \param wait If there are no commands available, it will block and wait
+	 * Executes the timers that are due, then the commands in each lane, starting with the highest priority lane.
+	 * For each lane, it only executes the commands that were there at the start of the tick (up to the lane's budget), so it
+	 * never gets stuck if commands are sent faster than they can be executed.
+	 *
+	 * \param wait If there are no commands available, it will block and wait until there are, or until the next timer is due
+	 * \return Number of commands executed (including timers)
 	 */
-	void tickImpl(bool wait);
+	size_t tickImpl(bool wait);
 
-	WorkQueue m_queue;
+	/**
+	 * Makes any thread blocked in `tickImpl` return, and stops it from blocking again.
+	 */
+	void requestStop();
+
+	bool isStopRequested() const
+	{
+		return m_stopRequested.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Called the first time a command or timer is sent, if `m_lazyStartPending` is set.
+	 * Allows derived classes to delay creating threads until they are needed.
+	 */
+	virtual void lazyStart()
+	{
+	}
+
+	void checkLazyStart()
+	{
+		if (m_lazyStartPending.load(std::memory_order_acquire)) [[unlikely]]
+		{
+			lazyStart();
+		}
+	}
+
+	std::atomic<bool> m_lazyStartPending = false;
+
+	WorkQueue& getLane(CommandPriority priority)
+	{
+		return m_lanes[static_cast<size_t>(priority)];
+	}
+
+private:
+	// Gets the number of commands in each lane, and returns the total
+	size_t calcLaneSizes(size_t (&sizes)[NumCommandPriorities]) const;
+
+	TimerId addTimer(TimerWheel::Clock::time_point point, TimerWheel::Clock::duration period, Command&& f);
+	// Moves expired timers to the due list, and returns how many there are
+	size_t collectTimers();
+	size_t executeTimers();
+	// Executes a command, recording how long it took if instrumented
+	void execute(Command& f);
+	// Blocks until there are commands in a lane, a timer is due, or a new timer is added
+	void waitForWork();
+
+	WorkQueue m_lanes[NumCommandPriorities];
+	size_t m_budgets[NumCommandPriorities] = {SIZE_MAX, SIZE_MAX, SIZE_MAX};
+	// Allows waiting for commands in any of the lanes, or new timers
+	EventCount m_event;
+
+	std::mutex m_timersMtx;
+	TimerWheel m_timers;
+	// Incremented whenever a timer is added, so a sleeping consumer knows it needs to recalculate when to wake up
+	std::atomic<uint32_t> m_timersVersion = 0;
+	std::atomic<bool> m_stopRequested = false;
+	QueueStats* m_stats = nullptr;
 };
 
 
@@ -40,21 +190,151 @@ executed
 class AsyncCommandQueueExplicit : public AsyncCommandQueue
 {
 public:
-	void tick(bool wait);
+	// See AsyncCommandQueue::tickImpl
+	size_t tick(bool wait);
 };
 
 /*
-Command queue that creates a thread to execute the commands, thus being completely independent
+Command queue that creates its own threads to execute the commands, thus being completely independent.
+
+By default it uses a single thread, so commands are executed in the order they are sent (within each lane). With more than one
+worker, commands are executed in parallel, and only the order in which they start is guaranteed.
 */
 class AsyncCommandQueueAutomatic : public AsyncCommandQueue
 {
 public:
+
+	struct Options
+	{
+		// Number of threads draining the queue
+		uint32_t numWorkers = 1;
+		// Name for the worker threads. If there is more than one worker, the worker's index is appended to it
+		std::string threadName;
+		// Logical cores the workers can run on (bit N is core N). 0 means no restriction
+		uint64_t affinityMask = 0;
+		ThreadPriority priority = ThreadPriority::Normal;
+		// If true, the threads are only created when the first command or timer is sent
+		bool lazyStart = true;
+	};
+
 	AsyncCommandQueueAutomatic();
+	explicit AsyncCommandQueueAutomatic(Options options);
+
+	/**
+	 * Waits for all the commands sent so far to be executed, and then stops the workers.
+	 * Pending timers are discarded.
+	 */
 	virtual ~AsyncCommandQueueAutomatic();
+
+	/**
+	 * Returns true if the worker threads were created already
+	 */
+	bool isStarted() const
+	{
+		return !m_lazyStartPending.load(std::memory_order_acquire);
+	}
+
+protected:
+	virtual void lazyStart() override;
+
+private:
+	void start();
+	void run(uint32_t index);
+
+	Options m_options;
+	std::once_flag m_startFlag;
+	std::vector<std::thread> m_threads;
+};
+
+/*
+Command queue with its own thread, like AsyncCommandQueueAutomatic, but for when there is only one producer.
+Pushing a command is wait-free (unless the queue is full), and the producer only touches the OS if the consumer thread is parked.
+
+Only one thread can call `send` at any given time. It doesn't need to be always the same thread, as long as calls are
+serialized by something else (e.g: a mutex).
+
+When the queue is empty, the consumer thread spins for a little while before parking, so bursts of commands don't pay for a
+wake up every time.
+*/
+class AsyncCommandQueueSPSC
+{
+public:
+	explicit AsyncCommandQueueSPSC(size_t capacity = SPSCQueue<Command>::DefaultCapacity);
+	~AsyncCommandQueueSPSC();
+	AsyncCommandQueueSPSC(const AsyncCommandQueueSPSC&) = delete;
+	AsyncCommandQueueSPSC& operator=(const AsyncCommandQueueSPSC&) = delete; 
+
+	// To be called by the producer. If the queue is full, it spins until there is space
+	void send(Command&& f);
+
 private:
 	void run();
+
+	// How many times the consumer checks for commands before parking
+	static constexpr int SpinCount = 2000;
+
+	SPSCQueue<Command> m_queue;
+	std::atomic<bool> m_sleeping = false;
+	Semaphore m_wakeup;
 	std::thread m_thread;
-	bool m_finish= false;
+	bool m_finish = false;
+};
+
+/*
+Command queue that records commands into a double buffered CommandVector (see PolyChunkVector.h), and needs explicit ticking.
+
+Producers emplace the commands directly in the back buffer, so there is no heap allocation per command. When ticking, the
+consumer swaps the front and back buffers under a short lock, executes the batch linearly, and then clears it, reusing its
+memory. Once the buffers grow enough to hold a typical workload, recording commands doesn't allocate any memory.
+
+This is best suited for a consumer that ticks regularly (e.g: once per frame) and producers that send lots of small commands.
+*/
+class AsyncCommandQueueBuffered
+{
+public:
+	/*!
+	 * \param chunkCapacity Initial chunk capacity for each of the buffers. See CommandVector
+	 */
+	explicit AsyncCommandQueueBuffered(size_t chunkCapacity = 0);
+	AsyncCommandQueueBuffered(const AsyncCommandQueueBuffered&) = delete;
+	AsyncCommandQueueBuffered& operator=(const AsyncCommandQueueBuffered&) = delete; 
+
+	// To be called by any thread that wishes to send commands to the queue
+	template<typename F>
+	requires std::invocable<F>
+	void send(F&& f)
+	{
+		bool notify;
+		{
+			std::lock_guard lk(m_mtx);
+			// Explicitly decaying, so CommandVector stores a copy and not a reference if we get an lvalue
+			m_back->push(std::decay_t<F>(std::forward<F>(f)));
+			notify = m_waiting;
+		}
+
+		if (notify)
+		{
+			m_cv.notify_one();
+		}
+	}
+
+	/*!
+	 * Executes all the commands recorded since the last tick.
+	 * \param wait If there are no commands available, it will block and wait
+	 * \return Number of commands executed
+	 */
+	size_t tick(bool wait);
+
+private:
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	// True if the consumer is blocked waiting for commands
+	bool m_waiting = false;
+	CommandVector m_buffers[2];
+	// Buffer where producers record commands
+	CommandVector* m_back;
+	// Buffer being executed by the consumer
+	CommandVector* m_front;
 };
 
 } // namespace cz
@@ -0,0 +1,261 @@
+#pragma once
+
+#include "SharedPtr.h"
+
+/**
+ * Atomic versions of SharedPtr and WeakPtr, to publish snapshots of immutable data (e.g: configuration) to many readers.
+ *
+ * - AtomicSharedPtr
+ *		Equivalent to std::atomic<std::shared_ptr<T>>.
+ * - AtomicWeakPtr
+ *		Equivalent to std::atomic<std::weak_ptr<T>>.
+ *
+ * Both are lock-free. `load` costs a single atomic increment in the common case, and writers never block readers.
+ *
+ * How it works (split reference count):
+ *
+ * The atomic holds a 64 bits word with the control block pointer in the lower 48 bits, and a local counter in the upper 16 bits.
+ * When a pointer is stored, the atomic adds a batch of `BatchSize` references to the control block's counter, which it then
+ * hands out to readers:
+ *	- `load` increments the local counter (with a single fetch_add), and that gives the reader one of the references in the
+ *	  batch, without touching the control block.
+ *	- When half the batch is used up, the reader that noticed it adds the used references back to the control block, and resets
+ *	  the local counter accordingly.
+ *	- When the pointer is replaced, the writer releases whatever is left of the batch (`BatchSize - local counter`).
+ *
+ * Things to be aware of:
+ *	- While a pointer is held by an atomic, `use_count`/`weak_use_count` report values inflated by the unused references of the
+ *	  batch.
+ *	- Requires 64 bits pointers that fit in 48 bits, which is the case for user space pointers on x64 and ARM64.
+ */
+
+namespace cz
+{
+
+namespace details
+{
+
+	template<typename T, bool Weak>
+	class BasicAtomicSmartPtr
+	{
+	  public:
+
+		using PtrType = std::conditional_t<Weak, BasicWeakPtr<T, true, false>, BasicSharedPtr<T, true>>;
+		using ControlBlock = SharedPtrControlBlock<T, true>;
+
+		static constexpr bool is_always_lock_free = true;
+
+		BasicAtomicSmartPtr() noexcept = default;
+
+		BasicAtomicSmartPtr(PtrType ptr) noexcept
+			: m_word(pack(acquireBatch(std::move(ptr)), 0))
+		{
+		}
+
+		CZ_DELETE_COPY_AND_MOVE(BasicAtomicSmartPtr);
+
+		~BasicAtomicSmartPtr()
+		{
+			uint64_t word = m_word.load(std::memory_order_relaxed);
+			releaseBatch(getCtrl(word), getCount(word));
+		}
+
+		PtrType load() const noexcept
+		{
+			const uint64_t word = m_word.fetch_add(CountOne, std::memory_order_acquire);
+			ControlBlock* ctrl = getCtrl(word);
+			if (!ctrl)
+			{
+				// The local counter is meaningless for null pointers, so it doesn't matter if it wraps around.
+				return {};
+			}
+
+			// There always needs to be at least one reference left in the batch, so `exchange` can return it
+			const uint32_t count = getCount(word) + 1;
+			CZ_CHECK(count < BatchSize);
+			if (count >= BatchSize / 2)
+			{
+				refill(ctrl);
+			}
+
+			return PtrType::_internal_createFromAlreadyAcquiredBlock(ctrl);
+		}
+
+		void store(PtrType ptr) noexcept
+		{
+			exchange(std::move(ptr));
+		}
+
+		PtrType exchange(PtrType ptr) noexcept
+		{
+			const uint64_t old = m_word.exchange(pack(acquireBatch(std::move(ptr)), 0), std::memory_order_acq_rel);
+
+			// One of the references of the batch that weren't handed out to readers is the one we are returning
+			ControlBlock* ctrl = getCtrl(old);
+			if (ctrl)
+			{
+				const uint32_t unused = BatchSize - getCount(old);
+				if (unused > 1)
+				{
+					subRefs(ctrl, unused - 1);
+				}
+			}
+			return PtrType::_internal_createFromAlreadyAcquiredBlock(ctrl);
+		}
+
+		/**
+		 * Replaces the pointer with `desired` if it currently points to the same object as `expected`.
+		 * If it fails, `expected` is set to the current value.
+		 *
+		 * NOTE: Unlike std::atomic, when it fails, `expected` is loaded separately after the comparison, so it might be different
+		 * from what was compared against. There are no spurious failures, so `compare_exchange_weak` is the same as this.
+		 */
+		bool compare_exchange_strong(PtrType& expected, PtrType desired) noexcept
+		{
+			ControlBlock* desiredCtrl = acquireBatch(std::move(desired));
+			ControlBlock* expectedCtrl = getCtrl(expected);
+
+			uint64_t word = m_word.load(std::memory_order_relaxed);
+			while (getCtrl(word) == expectedCtrl)
+			{
+				if (m_word.compare_exchange_weak(
+						word, pack(desiredCtrl, 0), std::memory_order_acq_rel, std::memory_order_relaxed))
+				{
+					releaseBatch(expectedCtrl, getCount(word));
+					return true;
+				}
+			}
+
+			releaseBatch(desiredCtrl, 0);
+			expected = load();
+			return false;
+		}
+
+		bool compare_exchange_weak(PtrType& expected, PtrType desired) noexcept
+		{
+			return compare_exchange_strong(expected, std::move(desired));
+		}
+
+		operator PtrType() const noexcept
+		{
+			return load();
+		}
+
+		BasicAtomicSmartPtr& operator=(PtrType ptr) noexcept
+		{
+			store(std::move(ptr));
+			return *this;
+		}
+
+	  private:
+
+		// How many references the atomic holds for the current pointer, to hand out to readers
+		static constexpr uint32_t BatchSize = 1 << 15;
+		static constexpr int CountShift = 48;
+		static constexpr uint64_t CountOne = uint64_t(1) << CountShift;
+		static constexpr uint64_t PtrMask = CountOne - 1;
+
+		static_assert(sizeof(void*) == sizeof(uint64_t), "AtomicSharedPtr requires 64 bits pointers");
+
+		static uint64_t pack(ControlBlock* ctrl, uint32_t count) noexcept
+		{
+			const uint64_t ptr = reinterpret_cast<uint64_t>(ctrl);
+			CZ_CHECK((ptr & ~PtrMask) == 0);
+			return ptr | (uint64_t(count) << CountShift);
+		}
+
+		static ControlBlock* getCtrl(uint64_t word) noexcept
+		{
+			return reinterpret_cast<ControlBlock*>(word & PtrMask);
+		}
+
+		static ControlBlock* getCtrl(const PtrType& ptr) noexcept
+		{
+			return ptr._internal_peekBlock();
+		}
+
+		static uint32_t getCount(uint64_t word) noexcept
+		{
+			return static_cast<uint32_t>(word >> CountShift);
+		}
+
+		static void addRefs(ControlBlock* ctrl, uint32_t n) noexcept
+		{
+			if constexpr (Weak)
+				ctrl->addWeak(n);
+			else
+				ctrl->addStrong(n);
+		}
+
+		static void subRefs(ControlBlock* ctrl, uint32_t n) noexcept
+		{
+			if constexpr (Weak)
+				ctrl->subWeak(n);
+			else
+				ctrl->subStrong(n);
+		}
+
+		// Takes over `ptr`'s reference, and adds as many as necessary to have a full batch
+		static ControlBlock* acquireBatch(PtrType ptr) noexcept
+		{
+			ControlBlock* ctrl = ptr._internal_detachBlock();
+			if (ctrl)
+			{
+				addRefs(ctrl, BatchSize - 1);
+			}
+			return ctrl;
+		}
+
+		// Releases the references of a batch that weren't handed out to readers
+		static void releaseBatch(ControlBlock* ctrl, uint32_t count) noexcept
+		{
+			if (ctrl)
+			{
+				subRefs(ctrl, BatchSize - count);
+			}
+		}
+
+		/**
+		 * Moves references from the control block to the local counter, so readers don't run out.
+		 * The caller must be holding a reference, so the control block is guaranteed to be alive.
+		 */
+		void refill(ControlBlock* ctrl) const noexcept
+		{
+			uint64_t word = m_word.load(std::memory_order_relaxed);
+			const uint32_t count = getCount(word);
+			if (getCtrl(word) != ctrl || count < BatchSize / 2)
+			{
+				// Someone else replaced the pointer or refilled it already
+				return;
+			}
+
+			// Add the references first, so they are there before the local counter is reduced.
+			// The CAS is a release, so that a writer that replaces the pointer after this (and thus releases fewer references),
+			// is guaranteed to see the increment.
+			addRefs(ctrl, count);
+			while (getCtrl(word) == ctrl && getCount(word) >= count)
+			{
+				if (m_word.compare_exchange_weak(
+						word, word - count * CountOne, std::memory_order_release, std::memory_order_relaxed))
+				{
+					return;
+				}
+			}
+
+			// The pointer was replaced (and the writer already accounted for the references handed out), or another reader
+			// refilled it in the meantime, so undo what we added.
+			subRefs(ctrl, count);
+		}
+
+		mutable std::atomic<uint64_t> m_word = 0;
+	};
+
+} // namespace details
+
+template<typename T>
+using AtomicSharedPtr = details::BasicAtomicSmartPtr<T, false>;
+
+template<typename T>
+using AtomicWeakPtr = details::BasicAtomicSmartPtr<T, true>;
+
+} // namespace cz
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "Common.h"
+#include "Logging.h"
+
+namespace cz
+{
+
+/**
+ * Move-only `void()` callable with a configurable inline buffer, similar to std::move_only_function.
+ *
+ * Any callable whose size fits in `InlineSize` bytes (and is nothrow move constructible and not over-aligned) is stored inline
+ * and never touches the heap. Bigger callables are heap allocated, like std::function does.
+ *
+ * The default size makes `sizeof(Command)` a cache line, which is enough for a lambda capturing a std::string and a couple of
+ * pointers.
+ */
+template<size_t InlineSize = 64 - sizeof(void*)>
+class BasicCommand
+{
+  public:
+
+	BasicCommand() = default;
+
+	BasicCommand(std::nullptr_t)
+	{
+	}
+
+	template<typename F>
+	requires (!std::is_same_v<std::remove_cvref_t<F>, BasicCommand> && std::is_invocable_r_v<void, std::decay_t<F>&>)
+	BasicCommand(F&& f)
+	{
+		using Func = std::decay_t<F>;
+		if constexpr (fitsInline<Func>())
+		{
+			new (m_storage) Func(std::forward<F>(f));
+			m_vtable = &InlineVTable<Func>::table;
+		}
+		else
+		{
+			*reinterpret_cast<Func**>(m_storage) = new Func(std::forward<F>(f));
+			m_vtable = &HeapVTable<Func>::table;
+		}
+	}
+
+	BasicCommand(BasicCommand&& other) noexcept
+	{
+		moveFrom(other);
+	}
+
+	BasicCommand& operator=(BasicCommand&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			moveFrom(other);
+		}
+		return *this;
+	}
+
+	BasicCommand& operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	CZ_DELETE_COPY(BasicCommand);
+
+	~BasicCommand()
+	{
+		reset();
+	}
+
+	explicit operator bool() const
+	{
+		return m_vtable != nullptr;
+	}
+
+	void operator()()
+	{
+		CZ_CHECK(m_vtable);
+		m_vtable->invoke(m_storage);
+	}
+
+	/**
+	 * Tells if a callable of type F would be stored inline, without any heap allocations
+	 */
+	template<typename F>
+	static constexpr bool fitsInline()
+	{
+		return sizeof(F) <= InlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+	}
+
+  private:
+
+	struct VTable
+	{
+		void (*invoke)(void* storage);
+		// Move constructs into `dst` and destroys `src`
+		void (*move)(void* dst, void* src) noexcept;
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template<typename F>
+	struct InlineVTable
+	{
+		static constexpr VTable table = {
+			[](void* storage) { (*static_cast<F*>(storage))(); },
+			[](void* dst, void* src) noexcept
+			{
+				new (dst) F(std::move(*static_cast<F*>(src)));
+				static_cast<F*>(src)->~F();
+			},
+			[](void* storage) noexcept { static_cast<F*>(storage)->~F(); }};
+	};
+
+	template<typename F>
+	struct HeapVTable
+	{
+		static constexpr VTable table = {
+			[](void* storage) { (**static_cast<F**>(storage))(); },
+			[](void* dst, void* src) noexcept { *static_cast<F**>(dst) = *static_cast<F**>(src); },
+			[](void* storage) noexcept { delete *static_cast<F**>(storage); }};
+	};
+
+	void moveFrom(BasicCommand& other) noexcept
+	{
+		if (other.m_vtable)
+		{
+			other.m_vtable->move(m_storage, other.m_storage);
+			m_vtable = other.m_vtable;
+			other.m_vtable = nullptr;
+		}
+	}
+
+	void reset() noexcept
+	{
+		if (m_vtable)
+		{
+			m_vtable->destroy(m_storage);
+			m_vtable = nullptr;
+		}
+	}
+
+	static_assert(InlineSize >= sizeof(void*), "Inline buffer needs to be big enough to hold a pointer");
+
+	alignas(std::max_align_t) uint8_t m_storage[InlineSize];
+	const VTable* m_vtable = nullptr;
+};
+
+using Command = BasicCommand<>;
+
+} // namespace cz
@@ -9,6 +9,7 @@
 #include <memory>
 #include <chrono>
 #include <mutex>
+#include <shared_mutex>
 #include <cstdint>
 #include <unordered_map>
 #include <set>
@@ -20,8 +21,12 @@
 #include <condition_variable>
 #include <string_view>
 #include <span>
+#include <coroutine>
+#include <ranges>
 #include <stacktrace>
 #include <numeric>
+#include <optional>
+#include <bit>
 
 CZ_THIRD_PARTY_INCLUDES_START
 #include "utf8.h"
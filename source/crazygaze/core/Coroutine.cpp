@@ -0,0 +1,84 @@
+#include "Coroutine.h"
+#include "ThreadingUtils.h"
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+namespace cz
+{
+
+namespace details
+{
+
+namespace
+{
+	// Size classes are multiples of this
+	constexpr size_t FrameGranularity = 64;
+	constexpr size_t NumSizeClasses = 32;
+	// Anything bigger than this goes straight to the heap
+	constexpr size_t MaxPooledFrameSize = FrameGranularity * NumSizeClasses;
+
+	struct FreeFrame
+	{
+		FreeFrame* next;
+	};
+
+	struct alignas(CacheLineSize) FreeList
+	{
+		SpinLock lock;
+		FreeFrame* head = nullptr;
+	};
+
+	FreeList gFreeLists[NumSizeClasses];
+
+	size_t calcSizeClass(size_t size)
+	{
+		return (size + FrameGranularity - 1) / FrameGranularity - 1;
+	}
+}
+
+void* CoroutineFrameAllocator::allocate(size_t size)
+{
+	if (size > MaxPooledFrameSize)
+	{
+		return ::operator new(size);
+	}
+
+	size_t sizeClass = calcSizeClass(size);
+	FreeList& list = gFreeLists[sizeClass];
+	{
+		std::lock_guard lk(list.lock);
+		if (FreeFrame* frame = list.head)
+		{
+			list.head = frame->next;
+			return frame;
+		}
+	}
+
+	return ::operator new((sizeClass + 1) * FrameGranularity);
+}
+
+void CoroutineFrameAllocator::deallocate(void* ptr, size_t size)
+{
+	if (size > MaxPooledFrameSize)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	FreeList& list = gFreeLists[calcSizeClass(size)];
+	FreeFrame* frame = static_cast<FreeFrame*>(ptr);
+	std::lock_guard lk(list.lock);
+	frame->next = list.head;
+	list.head = frame;
+}
+
+} // namespace details
+
+} // namespace cz
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
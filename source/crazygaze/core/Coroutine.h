@@ -0,0 +1,278 @@
+#pragma once
+
+#include "Common.h"
+#include "Logging.h"
+
+namespace cz
+{
+
+namespace details
+{
+	/**
+	 * Allocator for coroutine frames.
+	 *
+	 * Frames are rounded up to size classes, and freed frames are kept in per size class free lists to be reused, so a steady
+	 * flow of coroutines doesn't touch the heap. Frames are often created in one thread and destroyed in another (the thread the
+	 * coroutine finished on), so the free lists are shared by all threads.
+	 * Frames bigger than the biggest size class are allocated directly from the heap.
+	 */
+	class CoroutineFrameAllocator
+	{
+	  public:
+		static void* allocate(size_t size);
+		static void deallocate(void* ptr, size_t size);
+	};
+
+	template<typename T>
+	class TaskPromise;
+
+	struct TaskPromiseBase
+	{
+		struct FinalAwaiter
+		{
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+
+			template<typename Promise>
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+			{
+				TaskPromiseBase& promise = h.promise();
+				if (promise.continuation)
+				{
+					return promise.continuation;
+				}
+
+				// Nobody is waiting for this task, so it needs to clean up after itself
+				if (promise.detached)
+				{
+					h.destroy();
+				}
+				return std::noop_coroutine();
+			}
+
+			void await_resume() noexcept
+			{
+			}
+		};
+
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		FinalAwaiter final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void unhandled_exception()
+		{
+			CZ_UNEXPECTED();
+		}
+
+		static void* operator new(size_t size)
+		{
+			return CoroutineFrameAllocator::allocate(size);
+		}
+
+		static void operator delete(void* ptr, size_t size)
+		{
+			CoroutineFrameAllocator::deallocate(ptr, size);
+		}
+
+		// Coroutine to resume when this one finishes
+		std::coroutine_handle<> continuation;
+		bool detached = false;
+	};
+} // namespace details
+
+/**
+ * Lazily started coroutine that produces a value of type T.
+ *
+ * - The coroutine only starts running when awaited (`co_await task`) or detached (`detach`).
+ * - When it finishes, the awaiting coroutine is resumed in the same thread with symmetric transfer, so long chains of tasks
+ *   don't grow the stack.
+ * - Frames come from a recycling allocator. See details::CoroutineFrameAllocator.
+ *
+ * Use `co_await resumeOn(executor)` to hop between threads.
+ */
+template<typename T = void>
+class [[nodiscard]] Task
+{
+  public:
+	using promise_type = details::TaskPromise<T>;
+
+	Task() = default;
+
+	explicit Task(std::coroutine_handle<promise_type> h)
+		: m_handle(h)
+	{
+	}
+
+	Task(Task&& other) noexcept
+		: m_handle(std::exchange(other.m_handle, nullptr))
+	{
+	}
+
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	CZ_DELETE_COPY(Task);
+
+	~Task()
+	{
+		reset();
+	}
+
+	bool valid() const
+	{
+		return m_handle != nullptr;
+	}
+
+	/**
+	 * Starts the coroutine in the calling thread, without anyone waiting for it.
+	 * The coroutine frame is destroyed when the coroutine finishes, and the Task is no longer valid after this.
+	 */
+	void detach()
+	{
+		CZ_CHECK(m_handle);
+		auto h = std::exchange(m_handle, nullptr);
+		h.promise().detached = true;
+		h.resume();
+	}
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter
+		{
+			std::coroutine_handle<promise_type> handle;
+
+			bool await_ready() noexcept
+			{
+				return false;
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+			{
+				handle.promise().continuation = awaiting;
+				return handle;
+			}
+
+			T await_resume()
+			{
+				if constexpr (!std::is_void_v<T>)
+				{
+					return std::move(*handle.promise().value);
+				}
+			}
+		};
+
+		CZ_CHECK(m_handle);
+		return Awaiter{m_handle};
+	}
+
+	auto operator co_await() & noexcept
+	{
+		return std::move(*this).operator co_await();
+	}
+
+  private:
+
+	void reset()
+	{
+		if (m_handle)
+		{
+			m_handle.destroy();
+			m_handle = nullptr;
+		}
+	}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+namespace details
+{
+	template<typename T>
+	class TaskPromise : public TaskPromiseBase
+	{
+	  public:
+		Task<T> get_return_object()
+		{
+			return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+		}
+
+		template<typename U>
+		requires std::is_constructible_v<T, U&&>
+		void return_value(U&& v)
+		{
+			value.emplace(std::forward<U>(v));
+		}
+
+		std::optional<T> value;
+	};
+
+	template<>
+	class TaskPromise<void> : public TaskPromiseBase
+	{
+	  public:
+		Task<void> get_return_object()
+		{
+			return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+		}
+
+		void return_void()
+		{
+		}
+	};
+} // namespace details
+
+/**
+ * Awaitable that suspends the coroutine and resumes it in one of the executor's threads.
+ * `Executor` is anything with a `send(Command&&)` method (e.g: AsyncCommandQueue, ThreadPool).
+ *
+ * The command only holds the coroutine handle, so it never allocates.
+ *
+ * Example:
+ *	Task<> foo(AsyncCommandQueue& io, AsyncCommandQueue& main)
+ *	{
+ *		co_await resumeOn(io);
+ *		std::string data = readSomething();
+ *		co_await resumeOn(main);
+ *		process(data);
+ *	}
+ */
+template<typename Executor>
+auto resumeOn(Executor& executor)
+{
+	struct Awaiter
+	{
+		Executor& executor;
+
+		bool await_ready() noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			executor.send([h]() { h.resume(); });
+		}
+
+		void await_resume() noexcept
+		{
+		}
+	};
+
+	return Awaiter{executor};
+}
+
+} // namespace cz
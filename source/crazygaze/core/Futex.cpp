@@ -0,0 +1,117 @@
+#include "Futex.h"
+
+#if CZ_LINUX
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <cerrno>
+	#include <climits>
+#endif
+
+namespace cz
+{
+
+#if CZ_WINDOWS
+
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+	WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+}
+
+bool futexWaitFor(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+	// Rounding up, so we don't end up busy looping with 0ms waits
+	auto ms = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+	if (ms <= 0)
+		return false;
+
+	DWORD waitMs = ms >= INFINITE ? INFINITE - 1 : static_cast<DWORD>(ms);
+	if (WaitOnAddress(&word, &expected, sizeof(expected), waitMs))
+		return true;
+
+	return GetLastError() != ERROR_TIMEOUT;
+}
+
+void futexWakeOne(std::atomic<uint32_t>& word)
+{
+	WakeByAddressSingle(&word);
+}
+
+void futexWakeAll(std::atomic<uint32_t>& word)
+{
+	WakeByAddressAll(&word);
+}
+
+#elif CZ_LINUX
+
+namespace
+{
+	long futex(std::atomic<uint32_t>& word, int op, uint32_t val, const timespec* timeout)
+	{
+		return syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, val, timeout, nullptr, 0);
+	}
+}
+
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+	futex(word, FUTEX_WAIT_PRIVATE, expected, nullptr);
+}
+
+bool futexWaitFor(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+	if (timeout.count() <= 0)
+		return false;
+
+	timespec ts;
+	ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+	ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+	if (futex(word, FUTEX_WAIT_PRIVATE, expected, &ts) == 0)
+		return true;
+
+	return errno != ETIMEDOUT;
+}
+
+void futexWakeOne(std::atomic<uint32_t>& word)
+{
+	futex(word, FUTEX_WAKE_PRIVATE, 1, nullptr);
+}
+
+void futexWakeAll(std::atomic<uint32_t>& word)
+{
+	futex(word, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+}
+
+#else
+
+//
+// Fallback to std::atomic wait/notify, which doesn't support timeouts, so timed waits poll with small sleeps.
+//
+
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected)
+{
+	word.wait(expected);
+}
+
+bool futexWaitFor(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+	if (timeout.count() <= 0)
+		return false;
+
+	if (word.load() == expected)
+		std::this_thread::sleep_for(std::min(timeout, std::chrono::nanoseconds(std::chrono::milliseconds(1))));
+	return true;
+}
+
+void futexWakeOne(std::atomic<uint32_t>& word)
+{
+	word.notify_one();
+}
+
+void futexWakeAll(std::atomic<uint32_t>& word)
+{
+	word.notify_all();
+}
+
+#endif
+
+} // namespace cz
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Common.h"
+
+namespace cz
+{
+
+/**
+ * Thin wrappers around the OS's address based wait/wake primitives (futex on Linux, WaitOnAddress on Windows).
+ *
+ * They let a thread block until a 32-bit word changes, without any mutex or condition variable, so the data structure built on
+ * top only needs to touch the OS in the slow path.
+ *
+ * As with the raw OS primitives, waits can return spuriously, so callers must always re-check their condition.
+ */
+
+/**
+ * Blocks the calling thread if `word` still contains `expected`, until woken up by `futexWakeOne`/`futexWakeAll`.
+ */
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected);
+
+/**
+ * Similar to `futexWait`, but with a timeout.
+ * @return False if the timeout expired, true otherwise (woken up, spurious wake up, or `word` didn't contain `expected`)
+ */
+bool futexWaitFor(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout);
+
+/**
+ * Wakes up one thread blocked on `word`
+ */
+void futexWakeOne(std::atomic<uint32_t>& word);
+
+/**
+ * Wakes up all threads blocked on `word`
+ */
+void futexWakeAll(std::atomic<uint32_t>& word);
+
+} // namespace cz
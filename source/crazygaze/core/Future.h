@@ -0,0 +1,357 @@
+#pragma once
+
+#include "Common.h"
+#include "Command.h"
+#include "Logging.h"
+#include "ScopeGuard.h"
+#include "SlabPool.h"
+#include "ThreadingUtils.h"
+
+namespace cz
+{
+
+template<typename R>
+class Future;
+
+template<typename R>
+class Promise;
+
+namespace details
+{
+	template<typename R>
+	struct FutureState
+	{
+		using Value = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+		// Protects `value` and `continuation` while the value is not ready
+		SpinLock lock;
+		std::atomic<bool> ready = false;
+		// The promise and the future (or its continuation) each hold a reference
+		std::atomic<uint32_t> refs = 2;
+		bool futureRetrieved = false;
+		std::optional<Value> value;
+		// Executed by whoever makes the state ready (or by `then` if the state is already ready)
+		Command continuation;
+
+		static FutureState* create()
+		{
+			return SlabPool<FutureState>::create();
+		}
+
+		void release()
+		{
+			if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				SlabPool<FutureState>::destroy(this);
+			}
+		}
+
+		template<typename... Args>
+		void setValue(Args&&... args)
+		{
+			Command cont;
+			{
+				std::lock_guard lk(lock);
+				CZ_CHECK(!value);
+				value.emplace(std::forward<Args>(args)...);
+				ready.store(true, std::memory_order_release);
+				cont = std::move(continuation);
+			}
+
+			ready.notify_all();
+			if (cont)
+			{
+				cont();
+			}
+		}
+	};
+
+	template<typename F, typename R>
+	struct ContinuationResult
+	{
+		using Type = std::invoke_result_t<F, R>;
+	};
+
+	template<typename F>
+	struct ContinuationResult<F, void>
+	{
+		using Type = std::invoke_result_t<F>;
+	};
+} // namespace details
+
+/**
+ * Write end of a Future.
+ *
+ * Unlike std::promise, the shared state comes from a SlabPool and is synchronized with a SpinLock, so creating a promise/future
+ * pair doesn't allocate once the pool is warm.
+ *
+ * If a Promise is destroyed without setting a value (e.g: a command that was never executed), the Future never becomes ready and
+ * any continuations are destroyed without being executed.
+ */
+template<typename R>
+class Promise
+{
+  public:
+
+	Promise()
+		: m_state(details::FutureState<R>::create())
+	{
+	}
+
+	Promise(Promise&& other) noexcept
+		: m_state(std::exchange(other.m_state, nullptr))
+	{
+	}
+
+	Promise& operator=(Promise&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = std::exchange(other.m_state, nullptr);
+		}
+		return *this;
+	}
+
+	CZ_DELETE_COPY(Promise);
+
+	~Promise()
+	{
+		reset();
+	}
+
+	/**
+	 * Returns the future associated with this promise. Can only be called once.
+	 */
+	Future<R> getFuture()
+	{
+		CZ_CHECK(m_state && !m_state->futureRetrieved);
+		m_state->futureRetrieved = true;
+		return Future<R>(m_state);
+	}
+
+	template<typename T>
+	requires (!std::is_void_v<R> && std::is_constructible_v<R, T&&>)
+	void setValue(T&& value)
+	{
+		CZ_CHECK(m_state);
+		m_state->setValue(std::forward<T>(value));
+	}
+
+	void setValue() requires std::is_void_v<R>
+	{
+		CZ_CHECK(m_state);
+		m_state->setValue();
+	}
+
+  private:
+
+	void reset()
+	{
+		if (!m_state)
+			return;
+
+		// If the promise is abandoned, any continuation will never run, and it needs to be destroyed here, since it holds a
+		// reference to the state
+		Command cont;
+		{
+			std::lock_guard lk(m_state->lock);
+			if (!m_state->ready.load(std::memory_order_relaxed))
+				cont = std::move(m_state->continuation);
+		}
+		cont = nullptr;
+
+		// If nobody retrieved the future, then there is no one else to release that reference
+		if (!m_state->futureRetrieved)
+		{
+			m_state->release();
+		}
+		m_state->release();
+		m_state = nullptr;
+	}
+
+	details::FutureState<R>* m_state;
+};
+
+/**
+ * Read end of a Promise.
+ *
+ * A result can be retrieved by blocking with `get`, or without blocking any threads by attaching a continuation with `then`.
+ */
+template<typename R>
+class Future
+{
+  public:
+
+	Future() = default;
+
+	Future(Future&& other) noexcept
+		: m_state(std::exchange(other.m_state, nullptr))
+	{
+	}
+
+	Future& operator=(Future&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_state = std::exchange(other.m_state, nullptr);
+		}
+		return *this;
+	}
+
+	CZ_DELETE_COPY(Future);
+
+	~Future()
+	{
+		reset();
+	}
+
+	bool valid() const
+	{
+		return m_state != nullptr;
+	}
+
+	bool isReady() const
+	{
+		CZ_CHECK(m_state);
+		return m_state->ready.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Blocks until the value is ready
+	 */
+	void wait() const
+	{
+		CZ_CHECK(m_state);
+		m_state->ready.wait(false, std::memory_order_acquire);
+	}
+
+	/**
+	 * Blocks until the value is ready and returns it.
+	 * The future is no longer valid after this.
+	 */
+	R get()
+	{
+		wait();
+		CZ_CHECK(m_state->value);
+		CZ_SCOPE_EXIT { reset(); };
+		if constexpr (!std::is_void_v<R>)
+		{
+			return std::move(*m_state->value);
+		}
+	}
+
+	/**
+	 * Attaches a continuation that is sent to `executor` once the value is ready.
+	 *
+	 * `f` receives the value (or nothing, if R is void), and its result is made available through the returned future. This
+	 * never blocks. If the value is already ready, the continuation is sent right away.
+	 * `Executor` is anything with a `send(Command&&)` method (e.g: AsyncCommandQueue, ThreadPool).
+	 *
+	 * The future is no longer valid after this.
+	 */
+	template<typename Executor, typename F>
+	auto then(Executor& executor, F&& f) -> Future<typename details::ContinuationResult<std::decay_t<F>, R>::Type>
+	{
+		using U = typename details::ContinuationResult<std::decay_t<F>, R>::Type;
+		CZ_CHECK(m_state);
+
+		Promise<U> promise;
+		Future<U> res = promise.getFuture();
+
+		// The continuation takes over our reference to the state
+		details::FutureState<R>* state = m_state;
+		Command cont = [&executor, self = std::move(*this), promise = std::move(promise), f = std::forward<F>(f)]() mutable
+		{
+			executor.send([self = std::move(self), promise = std::move(promise), f = std::move(f)]() mutable
+			{
+				if constexpr (std::is_void_v<R>)
+				{
+					setPromise(promise, f);
+				}
+				else
+				{
+					setPromise(promise, f, std::move(*self.m_state->value));
+				}
+			});
+		};
+
+		{
+			std::lock_guard lk(state->lock);
+			if (!state->ready.load(std::memory_order_relaxed))
+			{
+				state->continuation = std::move(cont);
+				return res;
+			}
+		}
+
+		cont();
+		return res;
+	}
+
+  private:
+
+	template<typename>
+	friend class Promise;
+
+	template<typename>
+	friend class Future;
+
+	explicit Future(details::FutureState<R>* state)
+		: m_state(state)
+	{
+	}
+
+	template<typename U, typename F, typename... Args>
+	static void setPromise(Promise<U>& promise, F& f, Args&&... args)
+	{
+		if constexpr (std::is_void_v<U>)
+		{
+			f(std::forward<Args>(args)...);
+			promise.setValue();
+		}
+		else
+		{
+			promise.setValue(f(std::forward<Args>(args)...));
+		}
+	}
+
+	void reset()
+	{
+		if (m_state)
+		{
+			m_state->release();
+			m_state = nullptr;
+		}
+	}
+
+	details::FutureState<R>* m_state = nullptr;
+};
+
+/**
+ * Sends `f` to the executor, and returns a future for its result.
+ * `Executor` is anything with a `send(Command&&)` method (e.g: AsyncCommandQueue, ThreadPool).
+ */
+template<typename Executor, typename F>
+auto sendWithResult(Executor& executor, F&& f) -> Future<std::invoke_result_t<std::decay_t<F>&>>
+{
+	using R = std::invoke_result_t<std::decay_t<F>&>;
+	Promise<R> promise;
+	Future<R> res = promise.getFuture();
+	executor.send([promise = std::move(promise), f = std::forward<F>(f)]() mutable
+	{
+		if constexpr (std::is_void_v<R>)
+		{
+			f();
+			promise.setValue();
+		}
+		else
+		{
+			promise.setValue(f());
+		}
+	});
+	return res;
+}
+
+} // namespace cz
@@ -1,5 +1,7 @@
 #include "LogOutputs.h"
 #include "Algorithm.h"
+#include "MPMCQueue.h"
+#include "PlatformUtils.h"
 #include "StringUtils.h"
 
 namespace cz
@@ -36,14 +38,244 @@ static void printfLogMessage(LogMessage& msg)
 			break;
 	}
 
-	printf("%s%s%s", code, msg.formattedMsg.c_str(), resetCode);
+	printf("%s%.*s%s", code, static_cast<int>(msg.formattedMsg.size()), msg.formattedMsg.data(), resetCode);
 }
 
 static void printfLogMessageNoColour(LogMessage& msg)
 {
-	printf("%s", msg.formattedMsg.c_str());
+	printf("%.*s", static_cast<int>(msg.formattedMsg.size()), msg.formattedMsg.data());
 }
 
+//////////////////////////////////////////////////////////////////////////
+//	LogOutputs::AsyncBackend
+//////////////////////////////////////////////////////////////////////////
+
+struct LogOutputs::AsyncBackend
+{
+	// Size of the buffer entries have for the text of the message, or the arguments if the formatting was deferred.
+	// Messages with longer text need an allocation
+	static constexpr size_t DataSize = 256;
+	static_assert(DataSize >= details::MaxDeferredLogArgsSize);
+
+	struct Entry
+	{
+		struct Range
+		{
+			uint32_t offset = 0;
+			uint32_t size = 0;
+		};
+
+		bool debuggerOutput = false;
+		// Entries without a category are only used to wake up the backend thread, or as flush markers
+		LogCategoryBase* category = nullptr;
+		// If set, the backend thread sets it to 1 once the entry was dispatched, for whoever is waiting for it
+		std::atomic<uint32_t>* done = nullptr;
+		LogLevel level = LogLevel::Off;
+		uint64_t frame = 0;
+
+		// If set, the message still needs to be formatted, from the arguments in `data`
+		details::DeferredLogFormatFunc format = nullptr;
+		const details::LogSite* site = nullptr;
+		details::LogTimePoint time;
+
+		// For messages already formatted, where the text is in `data` (or `overflow`). The timestamp and message are usually
+		// part of the formatted message, in which case they are not stored separately.
+		Range formattedMsg;
+		Range msg;
+		Range timestamp;
+		uint32_t textSize = 0;
+		std::byte data[DataSize];
+		std::string overflow;
+
+		void setText(const LogMessage& src)
+		{
+			const std::string_view formatted = src.formattedMsg;
+			size_t size = formatted.size();
+			auto locate = [&](std::string_view str, size_t expectedPos, Range& dst)
+			{
+				if (expectedPos + str.size() <= formatted.size() && formatted.substr(expectedPos, str.size()) == str)
+				{
+					dst = {static_cast<uint32_t>(expectedPos), static_cast<uint32_t>(str.size())};
+				}
+				else
+				{
+					dst = {static_cast<uint32_t>(size), static_cast<uint32_t>(str.size())};
+					size += str.size();
+				}
+			};
+
+			formattedMsg = {0, static_cast<uint32_t>(formatted.size())};
+			locate(src.timestamp, 0, timestamp);
+			// The message is usually right before the line break
+			locate(src.msg, formatted.size() > src.msg.size() ? formatted.size() - src.msg.size() - 1 : 0, msg);
+
+			textSize = static_cast<uint32_t>(size);
+			char* dst = getText();
+			memcpy(dst, formatted.data(), formatted.size());
+			if (timestamp.offset >= formatted.size())
+				memcpy(dst + timestamp.offset, src.timestamp.data(), timestamp.size);
+			if (msg.offset >= formatted.size())
+				memcpy(dst + msg.offset, src.msg.data(), msg.size);
+		}
+
+		char* getText()
+		{
+			if (textSize <= DataSize)
+				return reinterpret_cast<char*>(data);
+
+			overflow.resize(textSize);
+			return overflow.data();
+		}
+
+		std::string_view getView(Range range)
+		{
+			return std::string_view(getText() + range.offset, range.size);
+		}
+	};
+
+	AsyncBackend(size_t capacity, QueueOverflowPolicy policy, bool deferFormatting)
+		: queue(capacity)
+		, policy(policy)
+		, deferFormatting(deferFormatting)
+	{
+	}
+
+	void push(Entry&& entry, QueueOverflowPolicy overflowPolicy)
+	{
+		while (!queue.tryPush(std::move(entry)))
+		{
+			if (overflowPolicy == QueueOverflowPolicy::DropNewest)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			else if (overflowPolicy == QueueOverflowPolicy::DropOldest)
+			{
+				Entry oldest;
+				if (queue.tryAndPop(oldest))
+				{
+					if (oldest.done)
+					{
+						// Someone is waiting for this one (a Fatal message or a flush), so it can't be dropped. Putting it back
+						// at the end still keeps it after everything that was queued before it.
+						push(std::move(oldest), QueueOverflowPolicy::Block);
+					}
+					else
+					{
+						dropped.fetch_add(1, std::memory_order_relaxed);
+						onDequeued();
+					}
+				}
+			}
+			else
+			{
+				// Sleep until the backend thread makes room
+				dequeuedEvent.wait([this, &entry]()
+				{
+					return queue.tryPush(std::move(entry));
+				});
+				return;
+			}
+		}
+	}
+
+	/**
+	 * The backend thread can't push to the queue, since it would block forever if the queue is full, so anything it logs
+	 * (e.g: an output failing an assert) needs to be dispatched right away.
+	 */
+	bool isBackendThread() const
+	{
+		return threadId.load(std::memory_order_relaxed) == std::this_thread::get_id();
+	}
+
+	// Called for every entry that leaves the queue, either because it was dispatched or dropped
+	void onDequeued()
+	{
+		dequeuedEvent.notifyAll();
+	}
+
+	/**
+	 * Pushes the entry and waits for the backend thread to dispatch it, which also means everything queued before it was
+	 * dispatched.
+	 */
+	void pushAndWait(Entry&& entry)
+	{
+		std::atomic<uint32_t> done = 0;
+		entry.done = &done;
+		push(std::move(entry), QueueOverflowPolicy::Block);
+		dequeuedEvent.wait([&done]()
+		{
+			return done.load(std::memory_order_acquire) != 0;
+		});
+	}
+
+	void run(LogOutputs& outer)
+	{
+		threadId.store(std::this_thread::get_id(), std::memory_order_relaxed);
+		setCurrentThreadName("Log");
+		Entry entry;
+		// Checking before waiting, so the entry `stopAsync` pushes to wake us up also ends the loop
+		while (!(stop.load(std::memory_order_acquire) && queue.empty()))
+		{
+			if (queue.waitAndPop(entry, 100))
+			{
+				if (entry.category)
+					dispatch(outer, entry);
+				// Once this is set, the waiting thread can destroy `done`, so we can't touch it anymore
+				if (entry.done)
+					entry.done->store(1, std::memory_order_release);
+				onDequeued();
+			}
+		}
+	}
+
+	void dispatch(LogOutputs& outer, Entry& entry)
+	{
+		LogMessage msg;
+		msg.category = entry.category;
+		msg.level = entry.level;
+		msg.frame = entry.frame;
+
+		if (entry.format)
+		{
+			buffers.msg.clear();
+			entry.format(entry.site->format, entry.data, buffers.msg);
+			msg.msg = buffers.msg;
+			details::formatLogMessage(msg, entry.time, buffers);
+			details::traceLogMessage(msg);
+		}
+		else
+		{
+			msg.formattedMsg = entry.getView(entry.formattedMsg);
+			msg.msg = entry.getView(entry.msg);
+			msg.timestamp = entry.getView(entry.timestamp);
+		}
+
+		outer.dispatch(entry.debuggerOutput, msg);
+	}
+
+	void flush()
+	{
+		// An empty entry works as a marker, since the queue is FIFO
+		pushAndWait(Entry());
+	}
+
+	MPMCQueue<Entry> queue;
+	QueueOverflowPolicy policy;
+	bool deferFormatting;
+	std::atomic<uint64_t> dropped = 0;
+	std::atomic<bool> stop = false;
+	EventCount dequeuedEvent;
+	std::thread thread;
+	std::atomic<std::thread::id> threadId;
+	// Used to format messages with deferred formatting
+	details::LogBuffers buffers;
+};
+
+//////////////////////////////////////////////////////////////////////////
+//	LogOutputs
+//////////////////////////////////////////////////////////////////////////
+
 LogOutputs::LogOutputs(bool colouredDefaultOutput)
 {
 	#if CZ_WINDOWS
@@ -55,32 +287,128 @@ LogOutputs::LogOutputs(bool colouredDefaultOutput)
 		add(this, printfLogMessageNoColour);
 }
 
+LogOutputs::~LogOutputs()
+{
+	stopAsync();
+}
+
 void LogOutputs::add(void* tag, LogFunc&& logFunc)
 {
-	auto lk = std::lock_guard<std::mutex>(m_mtx);
+	auto lk = std::lock_guard<std::recursive_mutex>(m_mtx);
 	m_outputs.push_back(std::make_pair(tag, std::move(logFunc)));
 }
 
 void LogOutputs::remove(void* tag)
 {
-	auto lk = std::lock_guard<std::mutex>(m_mtx);
+	auto lk = std::lock_guard<std::recursive_mutex>(m_mtx);
 	remove_if(m_outputs, [tag](std::pair<void*, LogFunc>& p)
 	{
 		return p.first == tag;
 	});
 }
 
+void LogOutputs::startAsync(size_t capacity, QueueOverflowPolicy policy, bool deferFormatting)
+{
+	CZ_CHECK(policy != QueueOverflowPolicy::Overwrite);
+	if (isAsync())
+		return;
+
+	auto backend = new AsyncBackend(capacity, policy, deferFormatting);
+	backend->thread = std::thread([this, backend]()
+	{
+		backend->run(*this);
+	});
+	m_async.store(backend, std::memory_order_release);
+}
+
+void LogOutputs::stopAsync()
+{
+	AsyncBackend* backend = m_async.exchange(nullptr, std::memory_order_acq_rel);
+	if (!backend)
+		return;
+
+	backend->stop.store(true, std::memory_order_release);
+	// Wake up the backend thread, so it doesn't have to wait for its timeout to notice
+	backend->push(AsyncBackend::Entry(), QueueOverflowPolicy::Block);
+	backend->thread.join();
+	delete backend;
+}
+
+void LogOutputs::flush()
+{
+	AsyncBackend* backend = m_async.load(std::memory_order_acquire);
+	// If the backend thread itself is logging (e.g: an output failed an assert), waiting for it would deadlock
+	if (backend && !backend->isBackendThread())
+	{
+		backend->flush();
+	}
+}
+
+uint64_t LogOutputs::getDroppedCount() const
+{
+	AsyncBackend* backend = m_async.load(std::memory_order_acquire);
+	return backend ? backend->dropped.load(std::memory_order_relaxed) : 0;
+}
+
 void LogOutputs::log(bool debuggerOutput, LogMessage& msg)
+{
+	AsyncBackend* backend = m_async.load(std::memory_order_acquire);
+	if (backend && !backend->isBackendThread())
+	{
+		// The process is about to abort on fatal messages, so those are never dropped, and we make sure they and everything
+		// before them reach the outputs
+		const bool fatal = msg.level == LogLevel::Fatal;
+		AsyncBackend::Entry entry;
+		entry.debuggerOutput = debuggerOutput;
+		entry.category = msg.category;
+		entry.level = msg.level;
+		entry.frame = msg.frame;
+		entry.setText(msg);
+		if (fatal)
+			backend->pushAndWait(std::move(entry));
+		else
+			backend->push(std::move(entry), backend->policy);
+	}
+	else
+	{
+		dispatch(debuggerOutput, msg);
+	}
+}
+
+bool LogOutputs::logDeferred(bool debuggerOutput, const details::LogSite& site, details::DeferredLogFormatFunc format,
+	size_t argsSize, void (*writeArgs)(std::byte* dst, const void* ctx), const void* ctx)
+{
+	AsyncBackend* backend = m_async.load(std::memory_order_acquire);
+	if (!backend || !backend->deferFormatting || argsSize > details::MaxDeferredLogArgsSize || backend->isBackendThread())
+		return false;
+
+	AsyncBackend::Entry entry;
+	entry.debuggerOutput = debuggerOutput;
+	entry.category = site.category;
+	entry.level = site.level;
+	entry.frame = gFrameCounter.load();
+	entry.format = format;
+	entry.site = &site;
+	entry.time = details::getLogTime();
+	writeArgs(entry.data, ctx);
+	backend->push(std::move(entry), backend->policy);
+	return true;
+}
+
+void LogOutputs::dispatch(bool debuggerOutput, LogMessage& msg)
 {
 	if (debuggerOutput)
 	{
 		#if CZ_WINDOWS
-			OutputDebugStringW(reinterpret_cast<LPCWSTR>(widen(msg.formattedMsg).c_str()));
+			// Reusing the buffer, so once it grew big enough, this doesn't allocate
+			thread_local std::wstring wideMsg;
+			widen(msg.formattedMsg, wideMsg);
+			OutputDebugStringW(reinterpret_cast<LPCWSTR>(wideMsg.c_str()));
 		#endif
 	}
 
 	{
-		auto lk = std::lock_guard<std::mutex>(m_mtx);
+		auto lk = std::lock_guard<std::recursive_mutex>(m_mtx);
 		for(auto&& f : m_outputs)
 		{
 			f.second(msg);
@@ -173,10 +501,39 @@ bool FileLogOutput::open(const std::string& inDirectory, const std::string& inFi
 
 void FileLogOutput::logMsg(LogMessage& msg)
 {
-	m_q.send([this, str = msg.formattedMsg]()
+	bool wasEmpty;
 	{
-		m_file << str;
-	});
+		auto lk = std::lock_guard<std::mutex>(m_pendingMtx);
+		wasEmpty = m_pending.empty();
+		m_pending += msg.formattedMsg;
+	}
+
+	// If there was something pending already, a write is queued and will pick this message up too
+	if (wasEmpty)
+	{
+		m_q.send([this]()
+		{
+			writePending();
+		});
+	}
+
+	// The process is about to abort, so wait for everything to reach the file
+	if (msg.level == LogLevel::Fatal)
+	{
+		finish();
+		m_finished.wait();
+	}
+}
+
+void FileLogOutput::writePending()
+{
+	{
+		auto lk = std::lock_guard<std::mutex>(m_pendingMtx);
+		std::swap(m_pending, m_writing);
+	}
+
+	m_file << m_writing;
+	m_writing.clear();
 }
 
 void FileLogOutput::finish()
@@ -190,18 +547,20 @@ void FileLogOutput::finish()
 
 FileLogOutput::~FileLogOutput()
 {
-	finish();
-	m_finished.wait();
-
-	if (!m_file.is_open())
+	// Remove ourselves from the outputs before sending anything from this thread, since `m_q` only supports one producer
+	// at a time.
+	// If logging is asynchronous, messages logged before this might still be queued, so flush those first.
+	if (m_file.is_open())
 	{
-		return;
+		if (LogOutputs* outputs = LogOutputs::tryGet())
+		{
+			outputs->flush();
+			outputs->remove(this);
+		}
 	}
 
-	if (LogOutputs* outputs = LogOutputs::tryGet())
-	{
-		outputs->remove(this);
-	}
+	finish();
+	m_finished.wait();
 }
 
 } // namespace cz
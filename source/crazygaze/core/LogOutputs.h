@@ -8,22 +8,89 @@
 namespace cz
 {
 
+/**
+ * Dispatches log messages to all the registered outputs.
+ *
+ * By default, messages are dispatched synchronously by the thread that logs them, which means all threads logging at the same
+ * time serialize on the slowest output (e.g: the console).
+ *
+ * In asynchronous mode (see `startAsync`), logging threads only push the message into a bounded lock-free queue, and a
+ * backend thread dispatches them to the outputs. Fatal messages are always flushed before returning, so they are not lost
+ * when the process aborts. Optionally, the formatting itself can also be left to the backend thread, which makes logging
+ * from the LOG macros little more than copying the arguments. Messages logged by the backend thread itself (e.g: from an
+ * output) are dispatched right away.
+ */
 class LogOutputs : public Singleton<LogOutputs>
 {
   public:
 	
 	LogOutputs(bool colouredDefaultOutput = true);
+	~LogOutputs();
 
 	using LogFunc = std::function<void(LogMessage& msg)>;
 
 	void add(void* tag, LogFunc&& logFunc);
 	void remove(void* tag);
+
+	/**
+	 * Dispatches the message to all the outputs.
+	 * In asynchronous mode, the message's text is copied to the queue (without allocating, unless it's very long), since
+	 * the views in `msg` are only valid during this call.
+	 */
 	void log(bool debuggerOutput, LogMessage& msg);
 
+	/**
+	 * Don't use this directly. Use the LOG macros.
+	 * Queues a message to be formatted by the backend thread. See `details::logDeferred`.
+	 * Returns false if not in asynchronous mode with deferred formatting, or the arguments are too big.
+	 */
+	bool logDeferred(bool debuggerOutput, const details::LogSite& site, details::DeferredLogFormatFunc format, size_t argsSize,
+		void (*writeArgs)(std::byte* dst, const void* ctx), const void* ctx);
+
+	/**
+	 * Switches to asynchronous mode.
+	 * This is meant to be called during startup, and `stopAsync` during shutdown, when no other threads are logging.
+	 *
+	 * @param capacity How many messages can be queued waiting for the backend thread.
+	 * @param policy What to do when the queue is full. `Overwrite` is not supported.
+	 * @param deferFormatting If true, the LOG macros copy the arguments and leave the formatting to the backend thread, when
+	 *	possible (see `details::logDeferred`).
+	 */
+	void startAsync(size_t capacity = 4096, QueueOverflowPolicy policy = QueueOverflowPolicy::Block, bool deferFormatting = true);
+
+	/**
+	 * Dispatches any queued messages, stops the backend thread and goes back to synchronous mode.
+	 * Does nothing if not in asynchronous mode.
+	 */
+	void stopAsync();
+
+	bool isAsync() const
+	{
+		return m_async.load(std::memory_order_acquire) != nullptr;
+	}
+
+	/**
+	 * Blocks until all the messages logged so far were dispatched to the outputs.
+	 * Does nothing if not in asynchronous mode.
+	 */
+	void flush();
+
+	/**
+	 * Number of messages discarded because the queue was full, since `startAsync` was called.
+	 */
+	uint64_t getDroppedCount() const;
+
   protected:
 
-	std::mutex m_mtx;
+	struct AsyncBackend;
+
+	void dispatch(bool debuggerOutput, LogMessage& msg);
+
+	// Recursive, so outputs can log (e.g: a failed assert), which dispatches the message right away to all the outputs
+	std::recursive_mutex m_mtx;
 	std::vector<std::pair<void*, LogFunc>> m_outputs;
+	// Only set while in asynchronous mode. Owned by us.
+	std::atomic<AsyncBackend*> m_async = nullptr;
 };
 
 
@@ -37,10 +104,18 @@ class FileLogOutput
 
   private:
 	void logMsg(LogMessage& msg);
+	void writePending();
 
 	void finish();
 
-	AsyncCommandQueueAutomatic m_q;
+	// `logMsg` is only called while holding LogOutputs' lock, so there is only ever one producer at a time
+	AsyncCommandQueueSPSC m_q;
+
+	// Messages are appended to m_pending, and the file thread swaps it with m_writing when it's ready to write more.
+	// Both strings keep their capacity, so once they grew big enough, logging doesn't allocate.
+	std::mutex m_pendingMtx;
+	std::string m_pending;
+	std::string m_writing;
 	std::ofstream m_file;
 	std::string m_filename;
 	Semaphore m_finished;
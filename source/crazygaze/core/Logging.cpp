@@ -2,6 +2,10 @@
 #include "StringUtils.h"
 #include "LogOutputs.h"
 
+#if CZ_LINUX
+	#include <time.h>
+#endif
+
 CZ_DEFINE_LOG_CATEGORY(Main)
 
 namespace cz
@@ -57,25 +61,101 @@ void doDebugBreak()
 #endif
 }
 
-/** Don't use this directly. Use the LOG macros */
-void logMessage(bool debuggerOutput, LogMessage& msg)
+namespace
+{
+	// One set of buffers per nesting level. See LogBuffersScope
+	thread_local std::vector<std::unique_ptr<LogBuffers>> tLogBuffers;
+	thread_local size_t tLogBuffersDepth = 0;
+
+	std::atomic<LogClock> gLogClock = LogClock::Precise;
+
+	/**
+	 * The "HH:MM:SS" part of the last timestamp formatted by a thread
+	 */
+	struct TimestampCache
+	{
+		int64_t secs = std::numeric_limits<int64_t>::min();
+		char text[8];
+	};
+	thread_local TimestampCache tTimestampCache;
+
+	LogTimePoint getCoarseTime()
+	{
+	#if CZ_WINDOWS
+		FILETIME ft;
+		GetSystemTimeAsFileTime(&ft);
+		// FILETIME counts 100ns intervals since 1601-01-01
+		constexpr uint64_t unixEpoch = 116444736000000000ULL;
+		const uint64_t ticks = (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+		return LogTimePoint(std::chrono::duration_cast<LogTimePoint::duration>(
+			std::chrono::duration<int64_t, std::ratio<1, 10000000>>(ticks - unixEpoch)));
+	#elif CZ_LINUX
+		timespec ts;
+		clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+		return LogTimePoint(std::chrono::duration_cast<LogTimePoint::duration>(
+			std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+	#else
+		#error "Unknown or unsupported platform"
+	#endif
+	}
+}
+
+LogBuffersScope::LogBuffersScope()
+{
+	if (tLogBuffersDepth == tLogBuffers.size())
+		tLogBuffers.push_back(std::make_unique<LogBuffers>());
+	m_buffers = tLogBuffers[tLogBuffersDepth++].get();
+	m_buffers->msg.clear();
+}
+
+LogBuffersScope::~LogBuffersScope()
+{
+	tLogBuffersDepth--;
+}
+
+LogTimePoint getLogTime()
+{
+	if (gLogClock.load(std::memory_order_relaxed) == LogClock::Coarse)
+		return getCoarseTime();
+	else
+		return std::chrono::system_clock::now();
+}
+
+void formatLogMessage(LogMessage& msg, LogTimePoint time, LogBuffers& buffers)
 {
-	auto nowMs = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::utc_clock::now());
+	auto nowMs = std::chrono::time_point_cast<std::chrono::milliseconds>(time);
 	auto nowSecs = std::chrono::time_point_cast<std::chrono::seconds>(nowMs);
-	auto ms = nowMs - nowSecs;
-	msg.timestamp = std::format("{:%H:%M:%S}:{:03d}", nowSecs, ms.count());
+	auto ms = static_cast<int>((nowMs - nowSecs).count());
+
+	// Formatting with chrono is slow, so only do it when the second changes, and patch in the milliseconds
+	TimestampCache& cache = tTimestampCache;
+	if (cache.secs != nowSecs.time_since_epoch().count())
+	{
+		std::format_to_n(cache.text, sizeof(cache.text), "{:%H:%M:%S}", nowSecs);
+		cache.secs = nowSecs.time_since_epoch().count();
+	}
+
+	std::string& out = buffers.formattedMsg;
+	out.clear();
+	out.append(cache.text, sizeof(cache.text));
+	const char msText[4] = {':', static_cast<char>('0' + ms / 100), static_cast<char>('0' + ms / 10 % 10),
+		static_cast<char>('0' + ms % 10)};
+	out.append(msText, sizeof(msText));
+	const size_t timestampSize = out.size();
 
 	// Only include frame number if the application is making use of it
 	if (msg.frame == std::numeric_limits<uint64_t>::max())
-		msg.formattedMsg = std::format("{}:{}:{}:{}\n", msg.timestamp, msg.category->getName(), msg.level, msg.msg);
+		std::format_to(std::back_inserter(out), ":{}:{}:{}\n", msg.category->getName(), msg.level, msg.msg);
 	else
-		msg.formattedMsg = std::format("{}[{}]:{}:{}:{}\n", msg.timestamp, msg.frame, msg.category->getName(), msg.level, msg.msg);
+		std::format_to(std::back_inserter(out), "[{}]:{}:{}:{}\n", msg.frame, msg.category->getName(), msg.level, msg.msg);
 
-	if (LogOutputs* logs = LogOutputs::tryGet())
-	{
-		logs->log(debuggerOutput, msg);
-	}
+	// Only now that we are done appending, since the buffer might have been reallocated
+	msg.timestamp = std::string_view(out.data(), timestampSize);
+	msg.formattedMsg = out;
+}
 
+void traceLogMessage([[maybe_unused]] const LogMessage& msg)
+{
 	#if TRACY_ENABLE
 	if (TracyIsConnected)
 	{
@@ -105,7 +185,25 @@ void logMessage(bool debuggerOutput, LogMessage& msg)
 		TracyMessageC(msg.formattedMsg.data(), msg.formattedMsg.size(), tracyColor);
 	}
 	#endif
+}
+
+/** Don't use this directly. Use the LOG macros */
+void logMessage(bool debuggerOutput, LogMessage& msg, LogBuffers& buffers)
+{
+	formatLogMessage(msg, getLogTime(), buffers);
+	traceLogMessage(msg);
+
+	if (LogOutputs* logs = LogOutputs::tryGet())
+	{
+		logs->log(debuggerOutput, msg);
+	}
+}
 
+bool pushDeferredLog(bool debuggerOutput, const LogSite& site, DeferredLogFormatFunc format, size_t argsSize,
+	void (*writeArgs)(std::byte* dst, const void* ctx), const void* ctx)
+{
+	LogOutputs* logs = LogOutputs::tryGet();
+	return logs && logs->logDeferred(debuggerOutput, site, format, argsSize, writeArgs, ctx);
 }
 
 
@@ -200,6 +298,11 @@ void setLogSettings(std::string_view logSettings)
 	});
 }
 
+void setLogClock(LogClock clock)
+{
+	details::gLogClock.store(clock, std::memory_order_relaxed);
+}
+
 } // namespace cz
 
 
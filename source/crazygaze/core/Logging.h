@@ -47,15 +47,18 @@ class LogCategoryBase;
 /*!
  * Puts together everything necessary for a log message.
  * This is then passed down to the logging code
+ *
+ * To avoid allocations, the strings are views of per-thread buffers that are reused from message to message, so they are only
+ * valid for the duration of the call to the log outputs. Outputs that need to keep the text around need to copy it.
  */
 struct LogMessage
 {
 	LogCategoryBase* category;
 	LogLevel level;
 	uint64_t frame = std::numeric_limits<uint64_t>::max();
-	std::string msg;
-	std::string timestamp;
-	std::string formattedMsg;
+	std::string_view msg;
+	std::string_view timestamp;
+	std::string_view formattedMsg;
 };
 
 namespace details
@@ -66,10 +69,194 @@ namespace details
 	 */
 	void doDebugBreak();
 
+	/**
+	 * Buffers the LogMessage strings are formatted into.
+	 * Since they are reused, once their capacity grows to fit the usual messages, logging doesn't allocate anything.
+	 */
+	struct LogBuffers
+	{
+		std::string msg;
+		// The timestamp is a prefix of this
+		std::string formattedMsg;
+	};
+
+	/**
+	 * Gives access to the calling thread's LogBuffers for the duration of a LOG macro.
+	 * There is a set of buffers per nesting level, so that logging from inside a log output or while formatting an argument
+	 * doesn't overwrite the outer message.
+	 */
+	class LogBuffersScope
+	{
+	  public:
+		LogBuffersScope();
+		~LogBuffersScope();
+		LogBuffersScope(const LogBuffersScope&) = delete;
+		LogBuffersScope& operator=(const LogBuffersScope&) = delete;
+
+		LogBuffers& get()
+		{
+			return *m_buffers;
+		}
+
+	  private:
+		LogBuffers* m_buffers;
+	};
+
 	/**
 	 * Don't use this directly. Use the LOG macros
 	 */
-	void logMessage(bool debuggerOutput, LogMessage& msg);
+	void logMessage(bool debuggerOutput, LogMessage& msg, LogBuffers& buffers);
+
+	using LogTimePoint = std::chrono::system_clock::time_point;
+
+	/**
+	 * Reads the clock selected with `setLogClock`
+	 */
+	LogTimePoint getLogTime();
+
+	/**
+	 * Formats the timestamp and the full message into `buffers.formattedMsg`, and points `msg.timestamp` and
+	 * `msg.formattedMsg` at it.
+	 * The "HH:MM:SS" part of the timestamp is cached per thread, so it's only formatted once per second.
+	 */
+	void formatLogMessage(LogMessage& msg, LogTimePoint time, LogBuffers& buffers);
+
+	/**
+	 * Sends the message to Tracy, if connected
+	 */
+	void traceLogMessage(const LogMessage& msg);
+
+	//
+	// Deferred formatting
+	//
+	// When LogOutputs is in asynchronous mode (see LogOutputs::startAsync), the LOG macros don't format the message on the
+	// calling thread if they can avoid it. Instead, they copy the raw arguments into the message queue, and the backend thread
+	// formats them later.
+	// This is only possible if all the arguments are scalars (numbers, enums, pointers), which are copied as is, or strings,
+	// whose characters are copied. Anything else (e.g: a class with a std::formatter specialization) could reference memory
+	// that doesn't exist anymore by the time it's formatted, so those messages are formatted right away as usual.
+	//
+
+	/**
+	 * Static information about a LOG macro call site
+	 */
+	struct LogSite
+	{
+		LogCategoryBase* category;
+		LogLevel level;
+		std::string_view format;
+	};
+
+	// Maximum size of the copied arguments. Messages with bigger arguments (e.g: long strings) are formatted right away
+	inline constexpr size_t MaxDeferredLogArgsSize = 192;
+
+	/**
+	 * Formats the message from the copied arguments, appending it to `out`
+	 */
+	using DeferredLogFormatFunc = void (*)(std::string_view format, const std::byte* args, std::string& out);
+
+	template<typename T>
+	concept LogStringArg = std::is_same_v<T, const char*> || std::is_same_v<T, char*> || std::is_same_v<T, std::string> ||
+		std::is_same_v<T, std::string_view>;
+
+	template<typename T>
+	concept DeferrableLogArg = LogStringArg<std::decay_t<T>> || std::is_scalar_v<std::decay_t<T>>;
+
+	// What the backend thread gets for each argument
+	template<typename T>
+	using DeferredLogArg_t = std::conditional_t<LogStringArg<T>, std::string_view, T>;
+
+	template<typename T>
+	size_t calcDeferredLogArgSize(const T& arg)
+	{
+		if constexpr (LogStringArg<std::decay_t<T>>)
+			return sizeof(uint32_t) + std::string_view(arg).size();
+		else
+			return sizeof(T);
+	}
+
+	template<typename T>
+	void writeDeferredLogArg(std::byte*& dst, const T& arg)
+	{
+		if constexpr (LogStringArg<std::decay_t<T>>)
+		{
+			std::string_view str(arg);
+			uint32_t size = static_cast<uint32_t>(str.size());
+			memcpy(dst, &size, sizeof(size));
+			memcpy(dst + sizeof(size), str.data(), size);
+			dst += sizeof(size) + size;
+		}
+		else
+		{
+			memcpy(dst, &arg, sizeof(T));
+			dst += sizeof(T);
+		}
+	}
+
+	template<typename T>
+	DeferredLogArg_t<T> readDeferredLogArg(const std::byte*& src)
+	{
+		if constexpr (LogStringArg<T>)
+		{
+			uint32_t size;
+			memcpy(&size, src, sizeof(size));
+			std::string_view str(reinterpret_cast<const char*>(src + sizeof(size)), size);
+			src += sizeof(size) + size;
+			return str;
+		}
+		else
+		{
+			T value;
+			memcpy(&value, src, sizeof(T));
+			src += sizeof(T);
+			return value;
+		}
+	}
+
+	template<typename... Args>
+	void formatDeferredLog(std::string_view format, const std::byte* args, std::string& out)
+	{
+		// Braced initialization, so the arguments are read in order
+		std::tuple<DeferredLogArg_t<Args>...> values{readDeferredLogArg<Args>(args)...};
+		std::apply([format, &out](auto&... v)
+		{
+			std::vformat_to(std::back_inserter(out), format, std::make_format_args(v...));
+		}, values);
+	}
+
+	/**
+	 * Queues a message whose arguments are written by `writeArgs`, if LogOutputs is in asynchronous mode.
+	 * Returns false if the message needs to be formatted right away.
+	 */
+	bool pushDeferredLog(bool debuggerOutput, const LogSite& site, DeferredLogFormatFunc format, size_t argsSize,
+		void (*writeArgs)(std::byte* dst, const void* ctx), const void* ctx);
+
+	/**
+	 * Don't use this directly. Use the LOG macros.
+	 * Returns false if the message needs to be formatted right away.
+	 */
+	template<typename... Args>
+	bool logDeferred(bool debuggerOutput, const LogSite& site, const Args&... args)
+	{
+		if constexpr ((DeferrableLogArg<Args> && ...))
+		{
+			using Tuple = std::tuple<const Args&...>;
+			const Tuple tuple(args...);
+			const size_t argsSize = (calcDeferredLogArgSize(args) + ... + 0);
+			return pushDeferredLog(debuggerOutput, site, &formatDeferredLog<std::decay_t<Args>...>, argsSize,
+				[](std::byte* dst, const void* ctx)
+				{
+					std::apply([&dst](const auto&... a)
+					{
+						(writeDeferredLogArg(dst, a), ...);
+					}, *static_cast<const Tuple*>(ctx));
+				}, &tuple);
+		}
+		else
+		{
+			return false;
+		}
+	}
 
 #if CZ_DEBUG
 	constexpr LogLevel compileTimeMaxLogLevel = LogLevel::VeryVerbose;
@@ -148,6 +335,23 @@ void setLogLevel(LogLevel level);
  */
 void setLogSettings(std::string_view logSettings);
 
+/**
+ * Clocks the log timestamps can be read from
+ */
+enum class LogClock : uint8_t
+{
+	// std::chrono::system_clock
+	Precise,
+	// The system time as of the last OS timer tick (CLOCK_REALTIME_COARSE on Linux, GetSystemTimeAsFileTime on Windows).
+	// The resolution is only a few milliseconds, but it's a lot cheaper to read.
+	Coarse
+};
+
+/**
+ * Sets the clock used for the log timestamps. The default is LogClock::Precise.
+ */
+void setLogClock(LogClock clock);
+
 } // namespace cz
 
 #define CZ_LOG_CHECK_COMPILETIME_LEVEL(name, verbosity) \
@@ -160,12 +364,22 @@ void setLogSettings(std::string_view logSettings);
 		{                                                                                                      \
 			if (!log##name.isSuppressed(::cz::LogLevel::logLevel))                                             \
 			{                                                                                                  \
-				::cz::LogMessage _cz_internal_msg;                                                             \
-				_cz_internal_msg.category = &log##name;                                                        \
-				_cz_internal_msg.frame = ::cz::gFrameCounter.load();                                           \
-				_cz_internal_msg.level = ::cz::LogLevel::logLevel;                                             \
-				_cz_internal_msg.msg = std::format(fmtStr, ##__VA_ARGS__);                                     \
-				::cz::details::logMessage(debuggerOutput, _cz_internal_msg);                                   \
+				static constexpr ::cz::details::LogSite _cz_internal_site{                                     \
+					&log##name, ::cz::LogLevel::logLevel, fmtStr};                                             \
+				/* Fatal messages are formatted right away, since the process is about to abort */             \
+				if (::cz::LogLevel::logLevel == ::cz::LogLevel::Fatal ||                                       \
+					!::cz::details::logDeferred(debuggerOutput, _cz_internal_site, ##__VA_ARGS__))             \
+				{                                                                                              \
+					::cz::details::LogBuffersScope _cz_internal_buffers;                                       \
+					std::string& _cz_internal_str = _cz_internal_buffers.get().msg;                            \
+					std::format_to(std::back_inserter(_cz_internal_str), fmtStr, ##__VA_ARGS__);               \
+					::cz::LogMessage _cz_internal_msg;                                                         \
+					_cz_internal_msg.category = &log##name;                                                    \
+					_cz_internal_msg.frame = ::cz::gFrameCounter.load();                                       \
+					_cz_internal_msg.level = ::cz::LogLevel::logLevel;                                         \
+					_cz_internal_msg.msg = _cz_internal_str;                                                   \
+					::cz::details::logMessage(debuggerOutput, _cz_internal_msg, _cz_internal_buffers.get());   \
+				}                                                                                              \
 			}                                                                                                  \
 		}                                                                                                      \
 		if constexpr (::cz::LogLevel::logLevel == ::cz::LogLevel::Fatal)                                       \
@@ -0,0 +1,304 @@
+#pragma once
+
+#include "Common.h"
+#include "Math.h"
+#include "ThreadingUtils.h"
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+namespace cz
+{
+
+/**
+ * Bounded, lock-free, multiple producer, multiple consumer queue.
+ *
+ * Based on Dmitry Vyukov's bounded MPMC queue:
+ * https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * Each slot has a sequence number that tells producers and consumers if the slot is ready for them, so producers and consumers
+ * only contend on the head/tail indexes (which live in their own cache lines) and never on a lock.
+ *
+ * It has the same public interface as SharedQueue (except `peek`, which can't be implemented safely without a lock, and the bulk
+ * operations), so it can be used as a drop-in replacement. The differences are:
+ *
+ * - The capacity is fixed at construction (rounded up to a power of 2). Once full, `push`/`emplace` spin (yielding the thread)
+ *   until a consumer frees a slot. Use `tryPush`/`tryEmplace` if that's not acceptable.
+ * - `size` is an approximation if there are concurrent producers or consumers.
+ * - Blocking consumers (`waitAndPop`) only touch a mutex/condition variable if the queue is empty. Producers only touch it if
+ *   there is a consumer blocked.
+ */
+template<typename T>
+class MPMCQueue
+{
+  public:
+
+	static constexpr size_t DefaultCapacity = 1024;
+
+	explicit MPMCQueue(size_t capacity = DefaultCapacity)
+	{
+		capacity = round_pow2(std::max(capacity, size_t(2)));
+		m_mask = capacity - 1;
+		m_cells = std::make_unique<Cell[]>(capacity);
+		for (size_t i = 0; i < capacity; i++)
+		{
+			m_cells[i].seq.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	~MPMCQueue()
+	{
+		// Destroy any items left in the queue
+		size_t enq = m_enqueuePos.load(std::memory_order_relaxed);
+		for (size_t pos = m_dequeuePos.load(std::memory_order_relaxed); pos != enq; pos++)
+		{
+			reinterpret_cast<T*>(m_cells[pos & m_mask].storage)->~T();
+		}
+	}
+
+	CZ_DELETE_COPY_AND_MOVE(MPMCQueue);
+
+	/**
+	 * Tries to queue a new item, constructing it in-place.
+	 *
+	 * @return True if the item was queued, false if the queue was full
+	 */
+	template<typename... Args>
+	bool tryEmplace(Args&&... args)
+	{
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (dif == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+			{
+				// The slot still has an item from the previous lap, so the queue is full
+				return false;
+			}
+			else
+			{
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		new (cell->storage) T(std::forward<Args>(args)...);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		m_dataEvent.notifyOne();
+		return true;
+	}
+
+	template<typename Arg>
+	bool tryPush(Arg&& item)
+	{
+		return tryEmplace(std::forward<Arg>(item));
+	}
+
+	/**
+	 * Queues a new item, constructing it in-place.
+	 * If the queue is full, it spins until there is space.
+	 *
+	 * @returns
+	 *	The approximate number of items in the queue (including the new one), at the time the new item was inserted.
+	 *  See SharedQueue::emplace
+	 */
+	template<typename... Args>
+	size_t emplace(Args&&... args)
+	{
+		unsigned spins = 0;
+		while (!tryEmplace(std::forward<Args>(args)...))
+		{
+			backoff(spins);
+		}
+		return size();
+	}
+
+	/**
+	 * Queues a new item
+	 * If the queue is full, it spins until there is space.
+	 *
+	 * @returns
+	 *	The approximate number of items in the queue (including the new one), at the time the new item was inserted.
+	 *  See SharedQueue::push
+	 */
+	template<typename Arg>
+	size_t push(Arg&& item)
+	{
+		return emplace(std::forward<Arg>(item));
+	}
+
+	/**
+	 * Tries to pop an item from the queue. It does not block waiting for items.
+	 * @return Returns true if an Items was retrieved
+	 */
+	bool tryAndPop(T& poppedItem)
+	{
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		unsigned spins = 0;
+		while (true)
+		{
+			cell = &m_cells[pos & m_mask];
+			size_t seq = cell->seq.load(std::memory_order_acquire);
+			intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (dif == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (dif < 0)
+			{
+				// The slot is empty. If no producer claimed it yet, then the queue is really empty.
+				// If a producer already claimed it, then it's in the middle of constructing the item, and we wait for it, since
+				// `size()` already accounted for that item, and code such as AsyncCommandQueue::tickImpl relies on `tryAndPop`
+				// succeeding in that case.
+				if (m_enqueuePos.load(std::memory_order_relaxed) == pos)
+					return false;
+				backoff(spins);
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+			else
+			{
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		T* item = reinterpret_cast<T*>(cell->storage);
+		poppedItem = std::move(*item);
+		item->~T();
+		cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Retrieves all items into the supplied queue.
+	 * See SharedQueue::popAll
+	 *
+	 * @param dest Queue used as destination queue.
+	 * @return True if the destination queue has any items, either because they were pushed or because the queue already had items
+	 */
+	bool popAll(std::queue<T>& dest)
+	{
+		T item;
+		while (tryAndPop(item))
+		{
+			dest.push(std::move(item));
+		}
+		return dest.size() != 0;
+	}
+
+	/**
+	 * Retrieves an item, blocking if necessary to wait for items.
+	 *
+	 * @return The item popped from the queue
+	 */
+	T waitAndPop()
+	{
+		T item;
+		if (!spinAndPop(item))
+		{
+			m_dataEvent.wait([this, &item] { return tryAndPop(item); });
+		}
+		return item;
+	}
+
+	/**
+	 * Retrieves an item, blocking if necessary for the specified duration until items arrive
+	 *
+	 * @param poppedItem Where to receive the popped item if the function returned true
+	 * @param timeoutMs Time to wait in milliseconds for an item to arrive
+	 *
+	 * @return True if an item was popped (poppedItem will contain the item), or false if the operation timed out
+	 */
+	bool waitAndPop(T& poppedItem, int64_t timeoutMs)
+	{
+		if (spinAndPop(poppedItem))
+			return true;
+
+		return m_dataEvent.waitFor(std::chrono::milliseconds(timeoutMs), [this, &poppedItem] { return tryAndPop(poppedItem); });
+	}
+
+	/** Checks if the queue is empty */
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	/**
+	 * Returns how many items there are in the queue.
+	 * This is an approximation if there are concurrent producers or consumers. Items that a producer is still constructing are
+	 * accounted for.
+	 */
+	unsigned size() const
+	{
+		// Loading the dequeue position first, so we never see dequeuePos > enqueuePos
+		size_t deq = m_dequeuePos.load(std::memory_order_relaxed);
+		size_t enq = m_enqueuePos.load(std::memory_order_relaxed);
+		return enq > deq ? static_cast<unsigned>(enq - deq) : 0;
+	}
+
+	size_t capacity() const
+	{
+		return m_mask + 1;
+	}
+
+  private:
+
+	static constexpr unsigned SpinCount = 64;
+
+	static void backoff(unsigned& spins)
+	{
+		if (spins < SpinCount)
+		{
+			spins++;
+			emitPause();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	/**
+	 * Before blocking, spin for a bit, since it's likely an item arrives soon if we are under load
+	 */
+	bool spinAndPop(T& item)
+	{
+		for (unsigned i = 0; i < SpinCount; i++)
+		{
+			if (tryAndPop(item))
+				return true;
+			emitPause();
+		}
+		return false;
+	}
+
+	struct Cell
+	{
+		std::atomic<size_t> seq;
+		alignas(T) uint8_t storage[sizeof(T)];
+	};
+
+	// Producers and consumers only write to these, so each one is in its own cache line
+	alignas(CacheLineSize) std::atomic<size_t> m_enqueuePos = 0;
+	alignas(CacheLineSize) std::atomic<size_t> m_dequeuePos = 0;
+
+	alignas(CacheLineSize) std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	EventCount m_dataEvent;
+};
+
+} // namespace cz
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
@@ -3,6 +3,13 @@
 #include "StringUtils.h"
 #include "Logging.h"
 
+#if CZ_LINUX
+	#include <pthread.h>
+	#include <sched.h>
+	#include <sys/resource.h>
+	#include <unistd.h>
+#endif
+
 namespace cz
 {
 
@@ -285,6 +292,56 @@ uint32_t getNumPhysicalCores()
 }
 #endif
 
+bool setCurrentThreadName(const std::string& name)
+{
+#if TRACY_ENABLE
+	tracy::SetThreadName(name.c_str());
+#endif
+
+#if CZ_WINDOWS
+	return SUCCEEDED(SetThreadDescription(GetCurrentThread(), widen(name).c_str()));
+#elif CZ_LINUX
+	// Linux limits names to 16 characters, including the null terminator
+	return pthread_setname_np(pthread_self(), name.substr(0, 15).c_str()) == 0;
+#else
+	return false;
+#endif
+}
+
+bool setCurrentThreadAffinity(uint64_t mask)
+{
+	CZ_CHECK(mask);
+#if CZ_WINDOWS
+	return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(mask)) != 0;
+#elif CZ_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int i = 0; i < 64; i++)
+	{
+		if (mask & (uint64_t(1) << i))
+			CPU_SET(i, &set);
+	}
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool setCurrentThreadPriority(ThreadPriority priority)
+{
+#if CZ_WINDOWS
+	static constexpr int values[] = {THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_BELOW_NORMAL, THREAD_PRIORITY_NORMAL,
+		THREAD_PRIORITY_ABOVE_NORMAL, THREAD_PRIORITY_HIGHEST};
+	return SetThreadPriority(GetCurrentThread(), values[static_cast<int>(priority)]) != 0;
+#elif CZ_LINUX
+	// On Linux, nice values apply per thread if we pass the thread id
+	static constexpr int values[] = {19, 10, 0, -5, -10};
+	return setpriority(PRIO_PROCESS, static_cast<id_t>(gettid()), values[static_cast<int>(priority)]) == 0;
+#else
+	return false;
+#endif
+}
+
 
 } // namespace cz
 
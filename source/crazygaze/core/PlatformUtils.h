@@ -37,6 +37,39 @@ fs::path getProcessExe();
  */
 uint32_t getNumPhysicalCores();
 
+/**
+ * Scheduling priority for threads.
+ * On Windows these map to the THREAD_PRIORITY_XXX values, and on Linux to nice values (where raising the priority above
+ * normal usually requires privileges).
+ */
+enum class ThreadPriority : uint8_t
+{
+	Lowest,
+	BelowNormal,
+	Normal,
+	AboveNormal,
+	Highest
+};
+
+/**
+ * Sets the calling thread's name, as shown by debuggers and profilers.
+ * On Linux, names are truncated to 15 characters.
+ * @return False if the platform doesn't support it or the call failed
+ */
+bool setCurrentThreadName(const std::string& name);
+
+/**
+ * Restricts the calling thread to the specified logical cores, where bit N is core N.
+ * @return False if the platform doesn't support it or the call failed (e.g: the mask doesn't include any existing core)
+ */
+bool setCurrentThreadAffinity(uint64_t mask);
+
+/**
+ * Sets the calling thread's scheduling priority.
+ * @return False if the platform doesn't support it or the call failed (e.g: lack of privileges)
+ */
+bool setCurrentThreadPriority(ThreadPriority priority);
+
 } // namespace cz
 
 
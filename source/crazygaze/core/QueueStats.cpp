@@ -0,0 +1,161 @@
+#include "QueueStats.h"
+
+namespace cz
+{
+
+//////////////////////////////////////////////////////////////////////////
+//	LatencyHistogram
+//////////////////////////////////////////////////////////////////////////
+
+void LatencyHistogram::add(uint64_t ns)
+{
+	buckets[calcBucket(ns)]++;
+	count++;
+	totalNs += ns;
+	maxNs = std::max(maxNs, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int i = 0; i < NumBuckets; i++)
+	{
+		buckets[i] += other.buckets[i];
+	}
+	count += other.count;
+	totalNs += other.totalNs;
+	maxNs = std::max(maxNs, other.maxNs);
+}
+
+std::chrono::nanoseconds LatencyHistogram::mean() const
+{
+	return std::chrono::nanoseconds(count ? totalNs / count : 0);
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double p) const
+{
+	if (count == 0)
+		return std::chrono::nanoseconds(0);
+
+	// Number of samples at or below the percentile, rounded up
+	const double exact = static_cast<double>(count) * p / 100.0;
+	uint64_t target = static_cast<uint64_t>(exact);
+	if (static_cast<double>(target) < exact)
+		target++;
+	target = std::max<uint64_t>(1, target);
+	uint64_t accumulated = 0;
+	for (int i = 0; i < NumBuckets - 1; i++)
+	{
+		accumulated += buckets[i];
+		if (accumulated >= target)
+		{
+			// Never report more than what was actually seen
+			return std::chrono::nanoseconds(std::min((uint64_t(1) << (i + 1)) - 1, maxNs));
+		}
+	}
+
+	return max();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//	QueueStats
+//////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+	std::atomic<uint32_t> gNextShardIndex = 0;
+	thread_local uint32_t tShardIndex = gNextShardIndex.fetch_add(1, std::memory_order_relaxed);
+}
+
+QueueStats::QueueStats(std::string name)
+	: m_name(std::move(name))
+{
+#if TRACY_ENABLE
+	if (!m_name.empty())
+	{
+		m_depthPlotName = m_name + " depth";
+		m_latencyPlotName = m_name + " latency (ns)";
+		TracyPlotConfig(m_depthPlotName.c_str(), tracy::PlotFormatType::Number, true, true, 0);
+		TracyPlotConfig(m_latencyPlotName.c_str(), tracy::PlotFormatType::Number, false, true, 0);
+	}
+#endif
+}
+
+QueueStats::Shard& QueueStats::getShard()
+{
+	return m_shards[tShardIndex % NumShards];
+}
+
+void QueueStats::recordPush(size_t count)
+{
+	getShard().pushed.fetch_add(count, std::memory_order_relaxed);
+	const int64_t depth = m_depth.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed) + static_cast<int64_t>(count);
+
+	int64_t highWater = m_highWaterDepth.load(std::memory_order_relaxed);
+	while (depth > highWater &&
+		   !m_highWaterDepth.compare_exchange_weak(highWater, depth, std::memory_order_relaxed, std::memory_order_relaxed))
+	{
+	}
+
+#if TRACY_ENABLE
+	if (!m_name.empty())
+		TracyPlot(m_depthPlotName.c_str(), depth);
+#endif
+}
+
+void QueueStats::recordPop(size_t count)
+{
+	getShard().popped.fetch_add(count, std::memory_order_relaxed);
+	[[maybe_unused]] const int64_t depth =
+		m_depth.fetch_sub(static_cast<int64_t>(count), std::memory_order_relaxed) - static_cast<int64_t>(count);
+
+#if TRACY_ENABLE
+	if (!m_name.empty())
+		TracyPlot(m_depthPlotName.c_str(), depth);
+#endif
+}
+
+void QueueStats::add(AtomicHistogram& h, std::chrono::nanoseconds duration)
+{
+	const uint64_t ns = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+	h.buckets[LatencyHistogram::calcBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	h.count.fetch_add(1, std::memory_order_relaxed);
+	h.totalNs.fetch_add(ns, std::memory_order_relaxed);
+
+	uint64_t currentMax = h.maxNs.load(std::memory_order_relaxed);
+	while (ns > currentMax &&
+		   !h.maxNs.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed, std::memory_order_relaxed))
+	{
+	}
+}
+
+void QueueStats::read(const AtomicHistogram& h, LatencyHistogram& dest)
+{
+	LatencyHistogram tmp;
+	for (int i = 0; i < LatencyHistogram::NumBuckets; i++)
+	{
+		tmp.buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+	}
+	tmp.count = h.count.load(std::memory_order_relaxed);
+	tmp.totalNs = h.totalNs.load(std::memory_order_relaxed);
+	tmp.maxNs = h.maxNs.load(std::memory_order_relaxed);
+	dest.merge(tmp);
+}
+
+QueueStats::Snapshot QueueStats::getSnapshot() const
+{
+	Snapshot res;
+	res.depth = m_depth.load(std::memory_order_relaxed);
+	res.highWaterDepth = m_highWaterDepth.load(std::memory_order_relaxed);
+	for (const Shard& shard : m_shards)
+	{
+		res.pushed += shard.pushed.load(std::memory_order_relaxed);
+		res.popped += shard.popped.load(std::memory_order_relaxed);
+		res.dropped += shard.dropped.load(std::memory_order_relaxed);
+		read(shard.queueLatency, res.queueLatency);
+		read(shard.execTime, res.execTime);
+		read(shard.lockWait, res.lockWait);
+	}
+	return res;
+}
+
+} // namespace cz
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Common.h"
+#include "ThreadingUtils.h"
+
+namespace cz
+{
+
+/**
+ * Histogram of durations, with power of 2 buckets.
+ * Bucket N holds durations in the [2^N, 2^(N+1)) nanoseconds range (bucket 0 also holds 0), which is plenty of resolution to
+ * spot where the time goes, and makes adding a sample just a couple of instructions.
+ *
+ * This is a plain value (not thread safe). See QueueStats for the thread safe version.
+ */
+struct LatencyHistogram
+{
+	// The last bucket holds anything from ~1 second up
+	static constexpr int NumBuckets = 31;
+
+	uint64_t buckets[NumBuckets] = {};
+	uint64_t count = 0;
+	uint64_t totalNs = 0;
+	uint64_t maxNs = 0;
+
+	static int calcBucket(uint64_t ns)
+	{
+		return ns ? std::min(NumBuckets - 1, static_cast<int>(std::bit_width(ns)) - 1) : 0;
+	}
+
+	void add(uint64_t ns);
+	void merge(const LatencyHistogram& other);
+
+	std::chrono::nanoseconds mean() const;
+	std::chrono::nanoseconds max() const
+	{
+		return std::chrono::nanoseconds(maxNs);
+	}
+
+	/**
+	 * Returns an upper bound for the specified percentile (0..100), which is the end of the bucket where the percentile falls.
+	 */
+	std::chrono::nanoseconds percentile(double p) const;
+};
+
+/**
+ * Instrumentation for queues (see SharedQueue::setStats and AsyncCommandQueue::setStats).
+ *
+ * Tracks:
+ *	- Current and high water depth
+ *	- Time items spend in the queue (enqueue to dequeue)
+ *	- Time spent executing commands, for queues that execute them
+ *	- Time spent waiting for the queue's lock, when it was contended
+ *	- Items dropped by bounded queues (see QueueOverflowPolicy)
+ *
+ * To keep the cost near zero, histograms and counters live in per-thread shards (each in its own cache line), so threads
+ * recording at the same time don't fight over cache lines. `getSnapshot` can be called from any thread, and adds up all the
+ * shards. Since shards are not updated atomically as a whole, a snapshot taken while the queue is in use is only approximately
+ * consistent.
+ *
+ * The same object can be shared by several queues, to have the combined numbers.
+ *
+ * If Tracy is enabled and a name is given, the depth and queue latency are also plotted in Tracy.
+ */
+class QueueStats
+{
+  public:
+
+	struct Snapshot
+	{
+		int64_t depth = 0;
+		int64_t highWaterDepth = 0;
+		uint64_t pushed = 0;
+		uint64_t popped = 0;
+		// Items discarded because the queue was full
+		uint64_t dropped = 0;
+		// Time items spent in the queue
+		LatencyHistogram queueLatency;
+		// Time spent executing commands
+		LatencyHistogram execTime;
+		// Time spent waiting for the queue's lock, only counting the times it was contended
+		LatencyHistogram lockWait;
+	};
+
+	explicit QueueStats(std::string name = "");
+	CZ_DELETE_COPY_AND_MOVE(QueueStats);
+
+	const std::string& getName() const
+	{
+		return m_name;
+	}
+
+	void recordPush(size_t count);
+	void recordPop(size_t count);
+
+	void recordDrop(size_t count)
+	{
+		getShard().dropped.fetch_add(count, std::memory_order_relaxed);
+	}
+
+	void recordQueueLatency(std::chrono::nanoseconds duration)
+	{
+		add(getShard().queueLatency, duration);
+	#if TRACY_ENABLE
+		if (!m_name.empty())
+			TracyPlot(m_latencyPlotName.c_str(), static_cast<int64_t>(duration.count()));
+	#endif
+	}
+
+	void recordExecTime(std::chrono::nanoseconds duration)
+	{
+		add(getShard().execTime, duration);
+	}
+
+	void recordLockWait(std::chrono::nanoseconds duration)
+	{
+		add(getShard().lockWait, duration);
+	}
+
+	Snapshot getSnapshot() const;
+
+  private:
+
+	struct AtomicHistogram
+	{
+		std::atomic<uint64_t> buckets[LatencyHistogram::NumBuckets] = {};
+		std::atomic<uint64_t> count = 0;
+		std::atomic<uint64_t> totalNs = 0;
+		std::atomic<uint64_t> maxNs = 0;
+	};
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+	struct alignas(CacheLineSize) Shard
+	{
+		std::atomic<uint64_t> pushed = 0;
+		std::atomic<uint64_t> popped = 0;
+		std::atomic<uint64_t> dropped = 0;
+		AtomicHistogram queueLatency;
+		AtomicHistogram execTime;
+		AtomicHistogram lockWait;
+	};
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
+
+	// Threads are spread over the shards, so unless there are more active threads than this, each one gets its own
+	static constexpr uint32_t NumShards = 16;
+
+	Shard& getShard();
+	static void add(AtomicHistogram& h, std::chrono::nanoseconds duration);
+	static void read(const AtomicHistogram& h, LatencyHistogram& dest);
+
+	std::string m_name;
+#if TRACY_ENABLE
+	std::string m_depthPlotName;
+	std::string m_latencyPlotName;
+#endif
+	alignas(CacheLineSize) std::atomic<int64_t> m_depth = 0;
+	std::atomic<int64_t> m_highWaterDepth = 0;
+	Shard m_shards[NumShards];
+};
+
+} // namespace cz
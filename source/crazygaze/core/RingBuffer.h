@@ -0,0 +1,178 @@
+#pragma once
+
+#include "Common.h"
+#include "Logging.h"
+
+namespace cz
+{
+
+/**
+ * Growable FIFO ring buffer, with the subset of std::deque's interface needed by std::queue.
+ *
+ * Unlike std::deque, it doesn't allocate or free memory as items are pushed and popped. It only allocates when it needs to grow
+ * (doubling the capacity), and it keeps that memory until destroyed. This matters for queues with a constant flow of items,
+ * since some std::deque implementations (e.g: MSVC's) allocate a block per item for anything bigger than a few bytes.
+ *
+ * Usage: std::queue<T, RingBuffer<T>>
+ */
+template<typename T>
+class RingBuffer
+{
+  public:
+	using value_type = T;
+	using size_type = size_t;
+	using reference = T&;
+	using const_reference = const T&;
+
+	RingBuffer() = default;
+
+	RingBuffer(RingBuffer&& other) noexcept
+	{
+		swap(*this, other);
+	}
+
+	RingBuffer& operator=(RingBuffer&& other) noexcept
+	{
+		if (this != &other)
+		{
+			RingBuffer tmp(std::move(other));
+			swap(*this, tmp);
+		}
+		return *this;
+	}
+
+	CZ_DELETE_COPY(RingBuffer);
+
+	~RingBuffer()
+	{
+		clear();
+	}
+
+	friend void swap(RingBuffer& a, RingBuffer& b) noexcept
+	{
+		std::swap(a.m_slots, b.m_slots);
+		std::swap(a.m_capacity, b.m_capacity);
+		std::swap(a.m_head, b.m_head);
+		std::swap(a.m_size, b.m_size);
+	}
+
+	template<typename... Args>
+	reference emplace_back(Args&&... args)
+	{
+		if (m_size == m_capacity)
+		{
+			grow();
+		}
+
+		T* item = new (slot(m_head + m_size)) T(std::forward<Args>(args)...);
+		m_size++;
+		return *item;
+	}
+
+	void push_back(const T& item)
+	{
+		emplace_back(item);
+	}
+
+	void push_back(T&& item)
+	{
+		emplace_back(std::move(item));
+	}
+
+	void pop_front()
+	{
+		CZ_CHECK(m_size);
+		slot(m_head)->~T();
+		m_head = (m_head + 1) & (m_capacity - 1);
+		m_size--;
+	}
+
+	reference front()
+	{
+		CZ_CHECK(m_size);
+		return *slot(m_head);
+	}
+
+	const_reference front() const
+	{
+		CZ_CHECK(m_size);
+		return *slot(m_head);
+	}
+
+	reference back()
+	{
+		CZ_CHECK(m_size);
+		return *slot(m_head + m_size - 1);
+	}
+
+	const_reference back() const
+	{
+		CZ_CHECK(m_size);
+		return *slot(m_head + m_size - 1);
+	}
+
+	size_type size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	size_type capacity() const
+	{
+		return m_capacity;
+	}
+
+	void clear()
+	{
+		while (m_size)
+		{
+			pop_front();
+		}
+		m_head = 0;
+	}
+
+  private:
+
+	struct Slot
+	{
+		alignas(T) uint8_t storage[sizeof(T)];
+	};
+
+	T* slot(size_t pos)
+	{
+		return reinterpret_cast<T*>(m_slots[pos & (m_capacity - 1)].storage);
+	}
+
+	const T* slot(size_t pos) const
+	{
+		return reinterpret_cast<const T*>(m_slots[pos & (m_capacity - 1)].storage);
+	}
+
+	void grow()
+	{
+		size_t newCapacity = m_capacity ? m_capacity * 2 : 16;
+		auto newSlots = std::make_unique<Slot[]>(newCapacity);
+		for (size_t i = 0; i < m_size; i++)
+		{
+			T* src = slot(m_head + i);
+			new (newSlots[i].storage) T(std::move(*src));
+			src->~T();
+		}
+
+		m_slots = std::move(newSlots);
+		m_capacity = newCapacity;
+		m_head = 0;
+	}
+
+	std::unique_ptr<Slot[]> m_slots;
+	// Always 0 or a power of 2
+	size_t m_capacity = 0;
+	size_t m_head = 0;
+	size_t m_size = 0;
+};
+
+} // namespace cz
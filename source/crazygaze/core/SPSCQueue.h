@@ -0,0 +1,202 @@
+#pragma once
+
+#include "Common.h"
+#include "Logging.h"
+#include "Math.h"
+#include "ThreadingUtils.h"
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+namespace cz
+{
+
+/**
+ * Bounded, wait-free, single producer, single consumer ring queue.
+ *
+ * Only one thread can push and only one thread can pop at any given time. The "single producer" doesn't need to be always the
+ * same thread, as long as pushes are serialized by something else (e.g: a mutex), and the same applies to the consumer side.
+ *
+ * The producer and the consumer each keep a cached copy of the other side's index, so in the common case neither side touches
+ * the other side's cache line.
+ *
+ * `tryPush`/`tryEmplace`/`tryAndPop` are wait-free. `push`/`emplace` spin if the queue is full.
+ */
+template<typename T>
+class SPSCQueue
+{
+  public:
+
+	static constexpr size_t DefaultCapacity = 1024;
+
+	explicit SPSCQueue(size_t capacity = DefaultCapacity)
+	{
+		capacity = round_pow2(std::max(capacity, size_t(2)));
+		m_mask = capacity - 1;
+		m_slots = std::make_unique<Slot[]>(capacity);
+	}
+
+	~SPSCQueue()
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		for (size_t pos = m_head.load(std::memory_order_relaxed); pos != tail; pos++)
+		{
+			slot(pos)->~T();
+		}
+	}
+
+	CZ_DELETE_COPY_AND_MOVE(SPSCQueue);
+
+	/**
+	 * Tries to queue a new item, constructing it in-place.
+	 * Can only be called from the producer.
+	 *
+	 * @return True if the item was queued, false if the queue was full
+	 */
+	template<typename... Args>
+	bool tryEmplace(Args&&... args)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_cachedHead > m_mask)
+		{
+			m_cachedHead = m_head.load(std::memory_order_acquire);
+			if (tail - m_cachedHead > m_mask)
+				return false;
+		}
+
+		new (slot(tail)) T(std::forward<Args>(args)...);
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	template<typename Arg>
+	bool tryPush(Arg&& item)
+	{
+		return tryEmplace(std::forward<Arg>(item));
+	}
+
+	/**
+	 * Queues a new item, constructing it in-place. If the queue is full, it spins until the consumer frees a slot.
+	 * Can only be called from the producer.
+	 */
+	template<typename... Args>
+	void emplace(Args&&... args)
+	{
+		unsigned spins = 0;
+		while (!tryEmplace(std::forward<Args>(args)...))
+		{
+			if (spins < 64)
+			{
+				spins++;
+				emitPause();
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	template<typename Arg>
+	void push(Arg&& item)
+	{
+		emplace(std::forward<Arg>(item));
+	}
+
+	/**
+	 * Returns a pointer to the item at the front of the queue, or nullptr if the queue is empty.
+	 * Can only be called from the consumer. The item stays in the queue until `pop` is called.
+	 */
+	T* front()
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_cachedTail)
+		{
+			m_cachedTail = m_tail.load(std::memory_order_acquire);
+			if (head == m_cachedTail)
+				return nullptr;
+		}
+
+		return slot(head);
+	}
+
+	/**
+	 * Removes the item at the front of the queue.
+	 * Can only be called from the consumer, and only after `front` returned non-null.
+	 */
+	void pop()
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		CZ_CHECK(head != m_tail.load(std::memory_order_relaxed));
+		slot(head)->~T();
+		m_head.store(head + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Tries to pop an item from the queue.
+	 * Can only be called from the consumer.
+	 *
+	 * @return Returns true if an item was retrieved
+	 */
+	bool tryAndPop(T& poppedItem)
+	{
+		T* item = front();
+		if (!item)
+			return false;
+
+		poppedItem = std::move(*item);
+		pop();
+		return true;
+	}
+
+	/**
+	 * Approximate number of items in the queue.
+	 */
+	size_t size() const
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		return tail > head ? tail - head : 0;
+	}
+
+	bool empty() const
+	{
+		return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed);
+	}
+
+	size_t capacity() const
+	{
+		return m_mask + 1;
+	}
+
+  private:
+
+	struct Slot
+	{
+		alignas(T) uint8_t storage[sizeof(T)];
+	};
+
+	T* slot(size_t pos)
+	{
+		return reinterpret_cast<T*>(m_slots[pos & m_mask].storage);
+	}
+
+	std::unique_ptr<Slot[]> m_slots;
+	size_t m_mask;
+
+	// Written by the consumer
+	alignas(CacheLineSize) std::atomic<size_t> m_head = 0;
+	size_t m_cachedTail = 0;
+
+	// Written by the producer
+	alignas(CacheLineSize) std::atomic<size_t> m_tail = 0;
+	size_t m_cachedHead = 0;
+};
+
+} // namespace cz
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
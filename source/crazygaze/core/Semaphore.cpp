@@ -1,70 +1,135 @@
 #include "Semaphore.h"
+#include "Logging.h"
+#include "ThreadingUtils.h"
 
 namespace cz
 {
 
 void Semaphore::notify()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	m_count++;
-	m_cv.notify_one();
+	int32_t old = m_count.fetch_add(1, std::memory_order_release);
+	if (old < 0)
+	{
+		// There is a thread blocked (or about to block)
+		m_wakeups.fetch_add(1, std::memory_order_release);
+		futexWakeOne(m_wakeups);
+	}
 }
 
 void Semaphore::wait()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	m_cv.wait(lock, [this]() {return m_count > 0; });
-	m_count--;
+	if (spinTryWait())
+		return;
+
+	if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+		return;
+
+	waitForWakeup();
 }
 
 bool Semaphore::trywait()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	if (m_count)
+	int32_t count = m_count.load(std::memory_order_relaxed);
+	while (count > 0)
 	{
-		m_count--;
-		return true;
+		if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
 	}
-	else
+	return false;
+}
+
+bool Semaphore::spinTryWait()
+{
+	int32_t limit = m_spinLimit.load(std::memory_order_relaxed);
+	for (int32_t i = 0; i < limit; i++)
 	{
-		return false;
+		if (trywait())
+		{
+			// Spinning paid off, so move the limit towards twice what it took, so it can handle a bit more variance.
+			// Races between threads updating this don't matter, since it's just a heuristic.
+			int32_t newLimit = limit + (i * 2 - limit) / 8;
+			m_spinLimit.store(std::clamp(newLimit, MinSpin, MaxSpin), std::memory_order_relaxed);
+			return true;
+		}
+		emitPause();
 	}
+
+	// Spinning was a waste of time, so spin less next time
+	m_spinLimit.store(std::max(limit / 2, MinSpin), std::memory_order_relaxed);
+	return false;
 }
 
-void ZeroSemaphore::increment()
+bool Semaphore::tryConsumeWakeup()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	m_count++;
+	uint32_t wakeups = m_wakeups.load(std::memory_order_relaxed);
+	while (wakeups > 0)
+	{
+		if (m_wakeups.compare_exchange_weak(wakeups, wakeups - 1, std::memory_order_acquire, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
 }
 
-void ZeroSemaphore::decrement()
+void Semaphore::waitForWakeup()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	m_count--;
-	m_cv.notify_all();
+	while (!tryConsumeWakeup())
+	{
+		futexWait(m_wakeups, 0);
+	}
 }
 
-void ZeroSemaphore::wait()
+bool Semaphore::cancelWait()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	m_cv.wait(lock, [this]()
+	int32_t count = m_count.load(std::memory_order_relaxed);
+	while (count < 0)
 	{
-		return m_count == 0;
-	});
+		if (m_count.compare_exchange_weak(count, count + 1, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
 }
 
-bool ZeroSemaphore::trywait()
+void ZeroSemaphore::increment()
+{
+	m_state.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ZeroSemaphore::decrement()
 {
-	std::unique_lock<LockableBase(std::mutex)> lock(m_mtx);
-	if (m_count == 0)
+	uint32_t old = m_state.fetch_sub(1, std::memory_order_acq_rel);
+	CZ_CHECK((old & CountMask) != 0);
+	if (old == (WaitersBit | 1))
 	{
-		return true;
+		// We reached 0 and there are threads waiting. Clearing the waiters bit only if no other thread incremented the count
+		// meanwhile, otherwise the waiters would just go back to sleep anyway.
+		uint32_t expected = WaitersBit;
+		if (m_state.compare_exchange_strong(expected, 0, std::memory_order_relaxed))
+		{
+			futexWakeAll(m_state);
+		}
 	}
-	else
+}
+
+void ZeroSemaphore::wait()
+{
+	uint32_t state = m_state.load(std::memory_order_acquire);
+	while ((state & CountMask) != 0)
 	{
-		return false;
+		if ((state & WaitersBit) == 0)
+		{
+			if (!m_state.compare_exchange_weak(state, state | WaitersBit, std::memory_order_acquire))
+				continue;
+			state |= WaitersBit;
+		}
+
+		futexWait(m_state, state);
+		state = m_state.load(std::memory_order_acquire);
 	}
 }
 
-} // namespace cz
+bool ZeroSemaphore::trywait()
+{
+	return (m_state.load(std::memory_order_acquire) & CountMask) == 0;
+}
 
+} // namespace cz
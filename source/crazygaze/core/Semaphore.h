@@ -1,18 +1,32 @@
 #pragma once
 
 #include "Common.h"
+#include "Futex.h"
 
 namespace cz
 {
 
+/**
+ * Lightweight counting semaphore.
+ *
+ * - `notify` is a single atomic increment if there are no threads blocked.
+ * - `wait` first spins for a bounded number of iterations, adapting that bound to how often spinning pays off, and only then
+ *   blocks on a futex.
+ *
+ * Based on Jeff Preshing's LightweightSemaphore (https://preshing.com/20150316/semaphores-are-surprisingly-versatile/), but with
+ * the OS semaphore replaced by a futex word that counts pending wake ups.
+ */
 class Semaphore
 {
 public:
 	Semaphore (unsigned int count = 0)
-		: m_count(count)
+		: m_count(static_cast<int32_t>(count))
 	{
 	}
 
+	Semaphore(const Semaphore&) = delete;
+	Semaphore& operator=(const Semaphore&) = delete;
+
 	void notify();
 	void wait();
 	bool trywait();
@@ -20,39 +34,79 @@ public:
 	template <class Clock, class Duration>
 	bool waitUntil(const std::chrono::time_point<Clock, Duration>& point)
 	{
-		std::unique_lock<std::mutex> lock(m_mtx);
-		if (!m_cv.wait_until(lock, point, [this]() { return m_count > 0; }))
+		if (spinTryWait())
+			return true;
+
+		if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+			return true;
+
+		while (true)
 		{
-			return false;
+			if (tryConsumeWakeup())
+				return true;
+
+			auto remaining = point - Clock::now();
+			if (remaining <= decltype(remaining)::zero() ||
+				!futexWaitFor(m_wakeups, 0, std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)))
+			{
+				if (cancelWait())
+					return false;
+
+				// A `notify` already accounted for us, so a wake up is coming
+				waitForWakeup();
+				return true;
+			}
 		}
-		m_count--;
-		return true;
 	}
+
 private:
-	TracyLockable(std::mutex, m_mtx);
-	std::condition_variable_any m_cv;
-	unsigned int m_count;
+
+	// Tries to decrement the count, spinning for a little while
+	bool spinTryWait();
+	// Consumes a pending wake up if there is one
+	bool tryConsumeWakeup();
+	// Blocks until we can consume a wake up
+	void waitForWakeup();
+	// Called when a timed wait expires, to undo the count decrement.
+	// Returns false if it was too late, because a notify already accounted for this waiter
+	bool cancelWait();
+
+	static constexpr int32_t MinSpin = 16;
+	static constexpr int32_t MaxSpin = 4096;
+
+	// If negative, it's the number of threads waiting (or about to wait)
+	std::atomic<int32_t> m_count;
+	// Number of pending wake ups for blocked threads. This is the futex word
+	std::atomic<uint32_t> m_wakeups = 0;
+	// How many times `wait` spins before blocking. Adjusted depending on how successful spinning is
+	std::atomic<int32_t> m_spinLimit = 256;
 };
 
 
 /**
  * A semaphore that blocks until the counter reaches 0
+ *
+ * The count and a "has waiters" flag share the same futex word, so `increment`/`decrement` are a single atomic operation unless
+ * a thread is blocked in `wait`.
  */
 class ZeroSemaphore
 {
   public:
 	ZeroSemaphore() {}
+	ZeroSemaphore(const ZeroSemaphore&) = delete;
+	ZeroSemaphore& operator=(const ZeroSemaphore&) = delete;
+
 	void increment();
 	void decrement();
 	void wait();
 	bool trywait();
 
   private:
-	TracyLockable(std::mutex, m_mtx);
-	std::condition_variable_any m_cv;
-	int m_count = 0;
+	static constexpr uint32_t WaitersBit = 0x80000000;
+	static constexpr uint32_t CountMask = ~WaitersBit;
+
+	std::atomic<uint32_t> m_state = 0;
 };
 
 } // namespace cz
 
-
@@ -19,6 +19,8 @@
  * - ObserverPtr
  *		A special kind of WeakPtr that doesn't allow promoting to SharedPtr. The purpose is just to check if a pointer is still valid.
  *		It has very little use, and it's unsafe if used with multi-threading.
+ *
+ * For lock-free atomic versions of SharedPtr and WeakPtr, see AtomicSharedPtr.h
  * 
  */
 
@@ -1,27 +1,117 @@
 #pragma once
 
 #include "Common.h"
+#include "Command.h"
+#include "QueueStats.h"
+#include "RingBuffer.h"
 
 namespace cz
 {
 
+/**
+ * What a bounded SharedQueue does when `push` or `emplace` is called while the queue is full
+ */
+enum class QueueOverflowPolicy : uint8_t
+{
+	// Blocks the producer until there is space
+	Block,
+	// Discards the item being pushed
+	DropNewest,
+	// Discards the item at the front of the queue to make room
+	DropOldest,
+	// Replaces the item at the back of the queue (the newest one) with the item being pushed. Useful when only the latest
+	// value matters (e.g: progress updates)
+	Overwrite
+};
+
 //
 // Multiple producer, multiple consumer thread safe queue
+// See MPMCQueue for a bounded lock-free alternative with the same interface.
+//
+// `Container` is the underlying container for the std::queue. Use RingBuffer<T> for queues with a constant flow of items, to
+// avoid allocations in push/pop.
+//
+// Instrumentation is opt-in, with `setStats`. When not used, it costs a null pointer check per operation.
+//
+// By default the queue is unbounded. A bounded queue applies backpressure according to its QueueOverflowPolicy when full.
+// `tryPush` and `pushFor` ignore the policy, and fail if the queue is full (after the timeout in the case of `pushFor`).
+// Producers blocked on a full queue are woken one per slot freed, so popping a single item doesn't wake all of them.
 //
-template<typename T>
+template<typename T, typename Container = std::deque<T>>
 class SharedQueue
 {
+public:
+	using Queue = std::queue<T, Container>;
+
 private:
-	std::queue<T> m_queue;
+	Queue m_queue;
 	mutable std::mutex m_mtx;
 	std::condition_variable m_data_cond;
+	// Used to wait for space, if the queue is bounded
+	std::condition_variable m_space_cond;
+	// 0 if unbounded
+	size_t m_capacity = 0;
+	QueueOverflowPolicy m_policy = QueueOverflowPolicy::Block;
+	unsigned m_waitingProducers = 0;
+	uint64_t m_dropped = 0;
+	QueueStats* m_stats = nullptr;
+	// When instrumented, the time each item in the queue was pushed, to measure how long items wait in the queue
+	RingBuffer<std::chrono::steady_clock::time_point> m_pushTimes;
 
 	SharedQueue& operator=(const SharedQueue&) = delete;
 	SharedQueue(const SharedQueue& other) = delete;
 
+	using TimePoint = std::chrono::steady_clock::time_point;
+
+	enum class PushMode
+	{
+		// Applies the overflow policy
+		Policy,
+		// Fails if the queue is full
+		Try,
+		// Waits for space until a deadline
+		Timed
+	};
+
 public:
 	SharedQueue(){}
 
+	/**
+	 * Creates a bounded queue
+	 * @param capacity Maximum number of items in the queue. 0 means unbounded
+	 * @param policy What to do if `push`/`emplace` are called while the queue is full
+	 */
+	explicit SharedQueue(size_t capacity, QueueOverflowPolicy policy = QueueOverflowPolicy::Block)
+		: m_capacity(capacity)
+		, m_policy(policy)
+	{
+	}
+
+	size_t getCapacity() const
+	{
+		return m_capacity;
+	}
+
+	/**
+	 * Number of items discarded so far because the queue was full (see QueueOverflowPolicy)
+	 */
+	uint64_t getDroppedCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		return m_dropped;
+	}
+
+	/**
+	 * Enables instrumentation, or disables it if null. See QueueStats.
+	 * Should be called before the queue is shared with other threads, while it's empty. `stats` must outlive the queue (or until
+	 * instrumentation is disabled).
+	 */
+	void setStats(QueueStats* stats)
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		CZ_CHECK(m_queue.empty());
+		m_stats = stats;
+	}
 
 	/**
 	 * Queues an new item, constructing it in-place.
@@ -30,15 +120,15 @@ public:
 	 *	The number of items in the queue (including the new one), at the time the new item was inserted.
 	 *	This is useful for scenario where the producer needs to kick start the consumer because the producer is only running
 	 *  when there are items in the queue.
+	 *	If the queue is bounded and the item was dropped or overwrote another item, it's the number of items in the queue.
 	 */
 	template<typename... Args>
 	size_t emplace(Args&&... args)
 	{
-		std::lock_guard<std::mutex> lock(m_mtx);
-		m_queue.emplace(std::forward<Args>(args)...);
-		auto size = m_queue.size();
-		m_data_cond.notify_one();
-		return size;
+		auto lock = acquireLock();
+		if (pushImpl(lock, PushMode::Policy, TimePoint(), std::forward<Args>(args)...))
+			m_data_cond.notify_one();
+		return m_queue.size();
 	}
 
 	/**
@@ -48,14 +138,67 @@ public:
 	 *	The number of items in the queue (including the new one), at the time the new item was inserted.
 	 *	This is useful for scenario where the producer needs to kick start the consumer because the producer is only running
 	 *  when there are items in the queue.
+	 *	If the queue is bounded and the item was dropped or overwrote another item, it's the number of items in the queue.
 	 */
 	template<typename Arg>
 	size_t push(Arg&& item){
-		std::lock_guard<std::mutex> lock(m_mtx);
-		m_queue.push(std::forward<Arg>(item));
-		auto size = m_queue.size();
+		auto lock = acquireLock();
+		if (pushImpl(lock, PushMode::Policy, TimePoint(), std::forward<Arg>(item)))
+			m_data_cond.notify_one();
+		return m_queue.size();
+	}
+
+	/**
+	 * Queues an item if there is space, ignoring the overflow policy.
+	 * @return True if the item was queued. If false, `item` is left untouched.
+	 */
+	template<typename Arg>
+	bool tryPush(Arg&& item)
+	{
+		auto lock = acquireLock();
+		if (!pushImpl(lock, PushMode::Try, TimePoint(), std::forward<Arg>(item)))
+			return false;
 		m_data_cond.notify_one();
-		return size;
+		return true;
+	}
+
+	/**
+	 * Queues an item, waiting up to `timeout` for space if the queue is full, ignoring the overflow policy.
+	 * @return True if the item was queued. If false, `item` is left untouched.
+	 */
+	template<typename Arg, typename Rep, typename Period>
+	bool pushFor(Arg&& item, std::chrono::duration<Rep, Period> timeout)
+	{
+		const TimePoint deadline = std::chrono::steady_clock::now() + timeout;
+		auto lock = acquireLock();
+		if (!pushImpl(lock, PushMode::Timed, deadline, std::forward<Arg>(item)))
+			return false;
+		m_data_cond.notify_one();
+		return true;
+	}
+
+	/**
+	 * Queues all the items in the range, taking the lock and waking up consumers only once.
+	 * If the queue is bounded, the overflow policy is applied to each item.
+	 * Items are pushed with the range's reference type, so to move them instead of copying, pass a range of rvalues (e.g:
+	 * `q.pushBulk(vec | std::views::as_rvalue)`).
+	 *
+	 * @returns
+	 *	The number of items in the queue (including the new ones), at the time the new items were inserted. See `push`.
+	 */
+	template<std::ranges::input_range Range>
+	size_t pushBulk(Range&& items)
+	{
+		return bulkImpl(std::forward<Range>(items));
+	}
+
+	/**
+	 * Similar to `pushBulk`, but constructs the items in-place, using each element of the range as the constructor argument.
+	 */
+	template<std::ranges::input_range Range>
+	size_t emplaceBulk(Range&& args)
+	{
+		return bulkImpl(std::forward<Range>(args));
 	}
 
 	/**
@@ -63,12 +206,13 @@ public:
 	 * @return Returns true if an Items was retrieved
 	 */
 	bool tryAndPop(T& poppedItem){
-		std::lock_guard<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		if (m_queue.empty()){
 			return false;
 		}
 		poppedItem = std::move(m_queue.front());
 		m_queue.pop();
+		onPopped(1);
 		return true;
 	}
 
@@ -80,7 +224,7 @@ public:
 	 */
 	T* peek()
 	{
-		std::lock_guard<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		if (m_queue.empty()){
 			return nullptr;
 		}
@@ -91,7 +235,7 @@ public:
 	 * Retrieves all items into the supplied queue.
 	 * This should be more efficient than retrieving one item at a time when a thread wants to process as many items as there
 	 * are currently in the queue. Example:
-	 * std::queue<Foo> local;
+	 * SharedQueue<Foo>::Queue local;
 	 * if (q.popAll(local)) {
 	 *     ... process items in local ...
 	 * }
@@ -99,9 +243,10 @@ public:
 	 * @param dest Queue used as destination queue.
 	 * @return True if the destination queue has any items, either because they were pushed or because the queue already had items
 	 */
-	bool popAll(std::queue<T>& dest)
+	bool popAll(Queue& dest)
 	{
-		std::lock_guard<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
+		onPopped(m_queue.size());
 
 		if (dest.size())
 		{
@@ -126,10 +271,11 @@ public:
 	 */
 	T waitAndPop()
 	{
-		std::unique_lock<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		m_data_cond.wait(lock, [this] { return !m_queue.empty();});
 		T item = std::move(m_queue.front());
 		m_queue.pop();
+		onPopped(1);
 		return item;
 	}
 
@@ -143,18 +289,68 @@ public:
 	 *
 	 */
 	bool waitAndPop(T& poppedItem, int64_t timeoutMs){
-		std::unique_lock<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		if (!m_data_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !m_queue.empty();}))
 			return false;
 
 		poppedItem = std::move(m_queue.front());
 		m_queue.pop();
+		onPopped(1);
 		return true;
 	}
 
+	/**
+	 * Pops up to `maxItems` items, appending them to `dest`. It does not block waiting for items.
+	 *
+	 * @return Number of items popped
+	 */
+	size_t popUpTo(std::vector<T>& dest, size_t maxItems)
+	{
+		auto lock = acquireLock();
+		return popUpToImpl(dest, maxItems);
+	}
+
+	/**
+	 * Pops up to `dest.size()` items, moving them into the start of `dest`. It does not block waiting for items.
+	 *
+	 * @return Number of items popped
+	 */
+	size_t popUpTo(std::span<T> dest)
+	{
+		auto lock = acquireLock();
+		return popUpToImpl(dest, dest.size());
+	}
+
+	/**
+	 * Pops up to `maxItems` items, appending them to `dest`, blocking for the specified duration if there are no items.
+	 *
+	 * @return Number of items popped, which is 0 if the operation timed out
+	 */
+	size_t waitAndPopUpTo(std::vector<T>& dest, size_t maxItems, int64_t timeoutMs)
+	{
+		auto lock = acquireLock();
+		if (!m_data_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !m_queue.empty();}))
+			return 0;
+		return popUpToImpl(dest, maxItems);
+	}
+
+	/**
+	 * Pops up to `dest.size()` items, moving them into the start of `dest`, blocking for the specified duration if there are no
+	 * items.
+	 *
+	 * @return Number of items popped, which is 0 if the operation timed out
+	 */
+	size_t waitAndPopUpTo(std::span<T> dest, int64_t timeoutMs)
+	{
+		auto lock = acquireLock();
+		if (!m_data_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !m_queue.empty();}))
+			return 0;
+		return popUpToImpl(dest, dest.size());
+	}
+
 	/** Checks if the queue is empty */
 	bool empty() const{
-		std::lock_guard<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		return m_queue.empty();
 	}
 
@@ -167,11 +363,201 @@ public:
 	 * add or remove items from the queue in between both calls.
 	 */
 	unsigned size() const{
-		std::lock_guard<std::mutex> lock(m_mtx);
+		auto lock = acquireLock();
 		return static_cast<unsigned>(m_queue.size());
 	}
+
+private:
+
+	std::unique_lock<std::mutex> acquireLock() const
+	{
+		if (!m_stats)
+			return std::unique_lock<std::mutex>(m_mtx);
+
+		// Only measuring if the lock is contended, so the uncontended case doesn't pay for reading the clock
+		std::unique_lock<std::mutex> lock(m_mtx, std::try_to_lock);
+		if (!lock.owns_lock())
+		{
+			auto start = std::chrono::steady_clock::now();
+			lock.lock();
+			m_stats->recordLockWait(std::chrono::steady_clock::now() - start);
+		}
+		return lock;
+	}
+
+	bool isFull() const
+	{
+		return m_capacity && m_queue.size() >= m_capacity;
+	}
+
+	/**
+	 * Pushes an item, dealing with a full queue according to `mode` and the overflow policy.
+	 * Doesn't wake up consumers, since the caller might want to push more items first.
+	 *
+	 * @return True if a new item was added to the queue
+	 */
+	template<typename... Args>
+	bool pushImpl(std::unique_lock<std::mutex>& lock, PushMode mode, TimePoint deadline, Args&&... args)
+	{
+		if (isFull())
+		{
+			if (mode == PushMode::Try)
+				return false;
+
+			if (mode == PushMode::Timed || m_policy == QueueOverflowPolicy::Block)
+			{
+				if (!waitForSpace(lock, mode == PushMode::Timed ? &deadline : nullptr))
+					return false;
+			}
+			else if (m_policy == QueueOverflowPolicy::DropNewest)
+			{
+				onDropped();
+				return false;
+			}
+			else if (m_policy == QueueOverflowPolicy::DropOldest)
+			{
+				m_queue.pop();
+				if (m_stats)
+				{
+					m_pushTimes.pop_front();
+					m_stats->recordPop(1);
+				}
+				onDropped();
+			}
+			else
+			{
+				m_queue.back() = T(std::forward<Args>(args)...);
+				onDropped();
+				return false;
+			}
+		}
+
+		m_queue.emplace(std::forward<Args>(args)...);
+		onPushed(1);
+		return true;
+	}
+
+	// Waits until the queue is not full. Returns false if the deadline was reached first
+	bool waitForSpace(std::unique_lock<std::mutex>& lock, const TimePoint* deadline)
+	{
+		// The queue might have filled up without consumers being notified (e.g: in the middle of a bulk push), and they need to
+		// make progress for us to be able to continue.
+		m_data_cond.notify_all();
+
+		m_waitingProducers++;
+		bool res = true;
+		if (deadline)
+			res = m_space_cond.wait_until(lock, *deadline, [this] { return !isFull(); });
+		else
+			m_space_cond.wait(lock, [this] { return !isFull(); });
+		m_waitingProducers--;
+		return res;
+	}
+
+	void onDropped()
+	{
+		m_dropped++;
+		if (m_stats)
+			m_stats->recordDrop(1);
+	}
+
+	// Called with the lock held, once `count` items were pushed
+	void onPushed(size_t count)
+	{
+		if (!m_stats)
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			m_pushTimes.push_back(now);
+		}
+		m_stats->recordPush(count);
+	}
+
+	// Called with the lock held, once `count` items were popped
+	void onPopped(size_t count)
+	{
+		if (count == 0)
+			return;
+
+		// Waking up only as many producers as slots were freed, to avoid a thundering herd
+		if (m_waitingProducers)
+		{
+			if (count >= m_waitingProducers)
+			{
+				m_space_cond.notify_all();
+			}
+			else
+			{
+				for (size_t i = 0; i < count; i++)
+					m_space_cond.notify_one();
+			}
+		}
+
+		if (!m_stats)
+			return;
+
+		auto now = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < count; i++)
+		{
+			m_stats->recordQueueLatency(now - m_pushTimes.front());
+			m_pushTimes.pop_front();
+		}
+		m_stats->recordPop(count);
+	}
+
+	template<typename Range>
+	size_t bulkImpl(Range&& items)
+	{
+		size_t count = 0;
+		size_t size;
+		{
+			auto lock = acquireLock();
+			for (auto&& item : items)
+			{
+				if (pushImpl(lock, PushMode::Policy, TimePoint(), std::forward<decltype(item)>(item)))
+					count++;
+			}
+			size = m_queue.size();
+		}
+
+		// Notifying outside the lock, so woken consumers don't immediately block on the mutex
+		if (count == 1)
+			m_data_cond.notify_one();
+		else if (count > 1)
+			m_data_cond.notify_all();
+
+		return size;
+	}
+
+	size_t popUpToImpl(std::vector<T>& dest, size_t maxItems)
+	{
+		// No `reserve` here, since callers that keep appending batches to the same vector would then get a reallocation per
+		// call, instead of push_back's geometric growth
+		size_t count = std::min(maxItems, m_queue.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			dest.push_back(std::move(m_queue.front()));
+			m_queue.pop();
+		}
+		onPopped(count);
+		return count;
+	}
+
+	size_t popUpToImpl(std::span<T> dest, size_t maxItems)
+	{
+		size_t count = std::min(maxItems, m_queue.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			dest[i] = std::move(m_queue.front());
+			m_queue.pop();
+		}
+		onPopped(count);
+		return count;
+	}
 };
-using WorkQueue = SharedQueue<std::function<void()>>;
+using WorkQueue = SharedQueue<Command, RingBuffer<Command>>;
 
 } // namespace cz
 
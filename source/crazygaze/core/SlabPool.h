@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Common.h"
+#include "ThreadingUtils.h"
+
+namespace cz
+{
+
+/**
+ * Thread safe pool of objects of type T, allocated in slabs.
+ *
+ * Memory is allocated `SlabSize` objects at a time, and freed objects go to a free list to be reused, so once the pool grows
+ * enough for a given workload, creating and destroying objects doesn't touch the heap.
+ * Slabs are never freed until the program exits.
+ *
+ * There is one pool per T, shared by all threads. The free list is protected by a SpinLock, so this is meant for small objects
+ * that are created and destroyed often (e.g: shared states for Future/Promise).
+ */
+template<typename T, size_t SlabSize = 64>
+class SlabPool
+{
+  public:
+
+	template<typename... Args>
+	static T* create(Args&&... args)
+	{
+		return new (allocate()) T(std::forward<Args>(args)...);
+	}
+
+	static void destroy(T* obj)
+	{
+		obj->~T();
+		deallocate(obj);
+	}
+
+  private:
+
+	union Slot
+	{
+		Slot* next;
+		alignas(T) uint8_t storage[sizeof(T)];
+	};
+
+	struct Data
+	{
+		SpinLock lock;
+		Slot* free = nullptr;
+		std::vector<std::unique_ptr<Slot[]>> slabs;
+	};
+
+	static Data& getData()
+	{
+		static Data data;
+		return data;
+	}
+
+	static void* allocate()
+	{
+		Data& data = getData();
+		std::lock_guard lk(data.lock);
+		if (!data.free)
+		{
+			auto slab = std::make_unique<Slot[]>(SlabSize);
+			for (size_t i = 0; i < SlabSize; i++)
+			{
+				slab[i].next = data.free;
+				data.free = &slab[i];
+			}
+			data.slabs.push_back(std::move(slab));
+		}
+
+		Slot* slot = data.free;
+		data.free = slot->next;
+		return slot->storage;
+	}
+
+	static void deallocate(void* ptr)
+	{
+		Data& data = getData();
+		Slot* slot = reinterpret_cast<Slot*>(ptr);
+		std::lock_guard lk(data.lock);
+		slot->next = data.free;
+		data.free = slot;
+	}
+};
+
+} // namespace cz
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "Common.h"
+#include "Command.h"
+#include "Futex.h"
+#include "Logging.h"
+#include "SlabPool.h"
+#include "ThreadingUtils.h"
+
+namespace cz
+{
+
+/**
+ * Serializes handlers on top of an executor, without dedicating a thread to the strand.
+ *
+ * Handlers posted to a strand are executed in FIFO order, and never concurrently, but they can run on any of the executor's
+ * threads. This is useful to serialize work for a given object (e.g: a connection) while using a shared thread pool.
+ *
+ * `Executor` can be anything with a `send(Command&&)` method that can be called from any thread (e.g: ThreadPool,
+ * AsyncCommandQueueAutomatic).
+ *
+ * An idle strand only costs a few words (executor reference, lock, and the head/tail of the handler list), so it's fine to have
+ * lots of them. The strand only has a command queued in the executor while it has handlers to run.
+ *
+ * The strand must outlive any handlers posted to it.
+ */
+template<typename Executor>
+class Strand
+{
+  public:
+
+	explicit Strand(Executor& executor)
+		: m_executor(executor)
+	{
+	}
+
+	~Strand()
+	{
+		// The last handler might have executed already (e.g: signalling that everything is done), with `run` still wrapping
+		// up, so we wait for it to finish before letting the strand go.
+		while (true)
+		{
+			{
+				std::lock_guard lk(m_mtx);
+				CZ_CHECK(m_head == nullptr);
+				if (!m_running.load(std::memory_order_relaxed))
+					break;
+				m_destroying = true;
+			}
+			futexWait(m_running, 1);
+		}
+	}
+
+	CZ_DELETE_COPY_AND_MOVE(Strand);
+
+	/**
+	 * Queues a handler for execution. It never runs the handler inline, even if called from inside the strand.
+	 */
+	void post(Command&& f)
+	{
+		CZ_CHECK(f);
+		Handler* h = SlabPool<Handler>::create(std::move(f));
+
+		{
+			std::lock_guard lk(m_mtx);
+			if (m_tail)
+				m_tail->next = h;
+			else
+				m_head = h;
+			m_tail = h;
+
+			if (m_running.load(std::memory_order_relaxed))
+				return;
+			m_running.store(1, std::memory_order_relaxed);
+		}
+
+		// The strand was idle, so we need to kick it off
+		m_executor.send([this]() { run(); });
+	}
+
+	/**
+	 * If called from a handler currently running in this strand, it executes the handler inline.
+	 * Otherwise it behaves like `post`.
+	 */
+	void dispatch(Command&& f)
+	{
+		if (runningInThisThread())
+		{
+			f();
+		}
+		else
+		{
+			post(std::move(f));
+		}
+	}
+
+	/**
+	 * Returns true if the calling thread is currently executing a handler from this strand
+	 */
+	bool runningInThisThread() const
+	{
+		return Callstack<Strand>::contains(this) != nullptr;
+	}
+
+	Executor& getExecutor()
+	{
+		return m_executor;
+	}
+
+  private:
+
+	// Handlers come from a SlabPool, so posting doesn't touch the heap once the pool has grown enough
+	struct Handler
+	{
+		Command f;
+		Handler* next = nullptr;
+	};
+
+	void run()
+	{
+		typename Callstack<Strand>::Context ctx(this);
+
+		// Only run the handlers that are queued at this point. If more are posted meanwhile, we queue another command in the
+		// executor, so a busy strand doesn't starve other commands
+		Handler* h;
+		{
+			std::lock_guard lk(m_mtx);
+			h = m_head;
+			m_head = m_tail = nullptr;
+		}
+
+		while (h)
+		{
+			h->f();
+			Handler* next = h->next;
+			SlabPool<Handler>::destroy(h);
+			h = next;
+		}
+
+		{
+			std::lock_guard lk(m_mtx);
+			if (m_head == nullptr)
+			{
+				m_running.store(0, std::memory_order_relaxed);
+				// Waking up the destructor while still holding the lock, since once we release it, the strand can be gone.
+				if (m_destroying)
+					futexWakeAll(m_running);
+				return;
+			}
+		}
+
+		m_executor.send([this]() { run(); });
+	}
+
+	Executor& m_executor;
+	SpinLock m_mtx;
+	// Set by the destructor if it needs to wait for `run` to finish
+	bool m_destroying = false;
+	// 1 while there is a command queued in the executor (or being executed) for this strand.
+	// It's a 32-bit word so the destructor can wait on it with futexWait.
+	std::atomic<uint32_t> m_running = 0;
+	Handler* m_head = nullptr;
+	Handler* m_tail = nullptr;
+};
+
+} // namespace cz
@@ -59,15 +59,21 @@ octet_iterator utf16to8_lenient (u16bit_iterator start, u16bit_iterator end, oct
 std::wstring widen(std::string_view str)
 {
 	std::wstring result;
+	widen(str, result);
+	return result;
+}
+
+void widen(std::string_view str, std::wstring& dst)
+{
+	dst.clear();
 	if constexpr(sizeof(std::wstring::value_type)==2)
 	{
-		utf8::unchecked::utf8to16(str.begin(), str.end(), std::back_inserter(result));
+		utf8::unchecked::utf8to16(str.begin(), str.end(), std::back_inserter(dst));
 	}
 	else
 	{
-		utf8::unchecked::utf8to32(str.begin(), str.end(), std::back_inserter(result));
+		utf8::unchecked::utf8to32(str.begin(), str.end(), std::back_inserter(dst));
 	}
-	return result;
 }
 
 std::string narrow(std::wstring_view str)
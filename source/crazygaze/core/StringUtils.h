@@ -20,6 +20,11 @@ std::string narrow(std::u32string_view str);
  */
  std::wstring widen(std::string_view str);
 
+/**
+ * Same as above, but converts into `dst`, reusing its capacity.
+ */
+void widen(std::string_view str, std::wstring& dst);
+
 /**
  * Using this, so we can use std::string as a key to the map, but not having to allocate a std::string every time we need to do a
  * lookup.
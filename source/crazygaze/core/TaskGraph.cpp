@@ -0,0 +1,231 @@
+#include "TaskGraph.h"
+#include "Futex.h"
+#include "Logging.h"
+#include "ThreadPool.h"
+
+namespace cz
+{
+
+/**
+ * State for a single run.
+ * It's reference counted, because the thread that finishes the last task still signals `done` after the caller might have
+ * returned from `run`.
+ */
+struct TaskGraph::RunState
+{
+	ThreadPool* pool;
+	std::chrono::steady_clock::time_point start;
+	// Tasks not finished yet
+	std::atomic<uint32_t> remaining;
+	// Set to 1 once all the tasks finished. This is the futex word the calling thread waits on
+	std::atomic<uint32_t> done = 0;
+
+	int64_t elapsedNs() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+TaskGraph::TaskId TaskGraph::add(std::string name, Command&& f)
+{
+	CZ_CHECK(!m_running);
+	CZ_CHECK(f);
+	auto node = std::make_unique<Node>();
+	node->name = std::move(name);
+	node->f = std::move(f);
+	m_nodes.push_back(std::move(node));
+	m_dirty = true;
+	return static_cast<TaskId>(m_nodes.size() - 1);
+}
+
+void TaskGraph::precede(TaskId before, TaskId after)
+{
+	CZ_CHECK(!m_running);
+	CZ_CHECK(before < m_nodes.size() && after < m_nodes.size() && before != after);
+	m_nodes[before]->successors.push_back(after);
+	m_nodes[after]->numPredecessors++;
+	m_dirty = true;
+}
+
+const std::string& TaskGraph::getName(TaskId task) const
+{
+	CZ_CHECK(task < m_nodes.size());
+	return m_nodes[task]->name;
+}
+
+bool TaskGraph::validate()
+{
+	CZ_CHECK(!m_running);
+	return prepare();
+}
+
+bool TaskGraph::prepare()
+{
+	if (!m_dirty)
+		return true;
+
+	m_order.clear();
+	m_roots.clear();
+
+	// Kahn's algorithm. Anything left out of the order once we run out of tasks without predecessors is part of a cycle
+	std::vector<uint32_t> inDegree(m_nodes.size());
+	for (TaskId id = 0; id < m_nodes.size(); id++)
+	{
+		inDegree[id] = m_nodes[id]->numPredecessors;
+		if (inDegree[id] == 0)
+		{
+			m_order.push_back(id);
+			m_roots.push_back(m_nodes[id].get());
+		}
+	}
+
+	for (size_t i = 0; i < m_order.size(); i++)
+	{
+		for (TaskId succ : m_nodes[m_order[i]]->successors)
+		{
+			if (--inDegree[succ] == 0)
+				m_order.push_back(succ);
+		}
+	}
+
+	if (m_order.size() != m_nodes.size())
+		return false;
+
+	m_dirty = false;
+	return true;
+}
+
+TaskGraph::RunStats TaskGraph::run(ThreadPool& pool)
+{
+	CZ_CHECK(!m_running);
+	RunStats stats;
+	if (m_nodes.empty())
+		return stats;
+
+	const bool valid = prepare();
+	CZ_CHECK_F(valid, "TaskGraph has cycles");
+	if (!valid)
+		return stats;
+
+	m_running = true;
+	for (auto& node : m_nodes)
+	{
+		node->pending.store(node->numPredecessors, std::memory_order_relaxed);
+	}
+
+	auto state = std::make_shared<RunState>();
+	state->pool = &pool;
+	state->start = std::chrono::steady_clock::now();
+	state->remaining.store(static_cast<uint32_t>(m_nodes.size()), std::memory_order_relaxed);
+
+	// The calling thread would be idle anyway, so it takes the first root for itself
+	for (size_t i = 1; i < m_roots.size(); i++)
+	{
+		schedule(state, m_roots[i]);
+	}
+	execute(state, m_roots[0]);
+
+	while (state->done.load(std::memory_order_acquire) == 0)
+	{
+		futexWait(state->done, 0);
+	}
+
+	stats.wallTime = std::chrono::steady_clock::now() - state->start;
+	calcStats(stats);
+	m_running = false;
+	return stats;
+}
+
+void TaskGraph::schedule(const std::shared_ptr<RunState>& state, Node* node)
+{
+	state->pool->send([this, state, node]()
+	{
+		execute(state, node);
+	});
+}
+
+void TaskGraph::execute(const std::shared_ptr<RunState>& state, Node* node)
+{
+	while (node)
+	{
+		node->startNs = state->elapsedNs();
+		{
+		#if TRACY_ENABLE
+			ZoneScoped;
+			ZoneName(node->name.c_str(), node->name.size());
+		#endif
+			node->f();
+		}
+		node->endNs = state->elapsedNs();
+
+		// Successors that became ready are queued, except one that we run ourselves, which saves a trip through the pool
+		Node* next = nullptr;
+		for (TaskId id : node->successors)
+		{
+			Node* succ = m_nodes[id].get();
+			if (succ->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				if (next)
+					schedule(state, succ);
+				else
+					next = succ;
+			}
+		}
+
+		// Once the last task is done, the graph can be destroyed at any time, so only the state can be touched
+		if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			state->done.store(1, std::memory_order_release);
+			futexWakeAll(state->done);
+			return;
+		}
+
+		node = next;
+	}
+}
+
+void TaskGraph::calcStats(RunStats& stats) const
+{
+	constexpr TaskId InvalidId = ~TaskId(0);
+
+	// Going through the tasks in dependency order, `pathTime[id]` is the longest chain of predecessors leading to `id`, and
+	// `prev[id]` the predecessor in that chain
+	std::vector<int64_t> pathTime(m_nodes.size(), 0);
+	std::vector<TaskId> prev(m_nodes.size(), InvalidId);
+	int64_t totalWork = 0;
+	int64_t longest = -1;
+	TaskId last = InvalidId;
+
+	for (TaskId id : m_order)
+	{
+		const Node& node = *m_nodes[id];
+		const int64_t duration = node.endNs - node.startNs;
+		totalWork += duration;
+
+		const int64_t pathEnd = pathTime[id] + duration;
+		if (pathEnd > longest)
+		{
+			longest = pathEnd;
+			last = id;
+		}
+
+		for (TaskId succ : node.successors)
+		{
+			if (prev[succ] == InvalidId || pathEnd > pathTime[succ])
+			{
+				pathTime[succ] = pathEnd;
+				prev[succ] = id;
+			}
+		}
+	}
+
+	stats.totalWork = std::chrono::nanoseconds(totalWork);
+	stats.criticalPathTime = std::chrono::nanoseconds(longest);
+	for (TaskId id = last; id != InvalidId; id = prev[id])
+	{
+		stats.criticalPath.push_back(id);
+	}
+	std::reverse(stats.criticalPath.begin(), stats.criticalPath.end());
+}
+
+} // namespace cz
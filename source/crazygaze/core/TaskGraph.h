@@ -0,0 +1,149 @@
+#pragma once
+
+#include "Common.h"
+#include "Command.h"
+
+namespace cz
+{
+
+class ThreadPool;
+
+/**
+ * A graph of tasks with dependencies between them, that is declared once and can be run repeatedly (e.g: once per frame).
+ *
+ * Running the graph never blocks a worker thread waiting for a dependency:
+ *	- Each task has an atomic counter with the number of predecessors that didn't finish yet.
+ *	- When a task finishes, it decrements its successors' counters, and those that reach zero are ready to run. The finishing
+ *	  thread runs one of those itself, and queues the others in the ThreadPool.
+ *
+ * The thread that calls `run` also runs tasks, and once it runs out of ready tasks, it's the only thread that blocks, waiting for
+ * the whole graph to finish.
+ *
+ * Every run also collects timings, including the critical path (the chain of dependent tasks that took the longest). That's
+ * the lower bound for the run's duration no matter how many threads are available, so it's what to optimize when the graph
+ * doesn't scale with more threads.
+ *
+ * Example:
+ *
+ *		TaskGraph graph;
+ *		TaskGraph::TaskId input = graph.add("input", [&]() { ... });
+ *		TaskGraph::TaskId physics = graph.add("physics", [&]() { ... });
+ *		TaskGraph::TaskId render = graph.add("render", [&]() { ... });
+ *		graph.precede(input, physics);
+ *		graph.precede(physics, render);
+ *		...
+ *		TaskGraph::RunStats stats = graph.run(pool);
+ */
+class TaskGraph
+{
+  public:
+
+	using TaskId = uint32_t;
+
+	struct RunStats
+	{
+		// From the start of `run` until the last task finished
+		std::chrono::nanoseconds wallTime{0};
+		// Sum of the time spent executing all the tasks
+		std::chrono::nanoseconds totalWork{0};
+		// Sum of the execution time of the tasks in the critical path
+		std::chrono::nanoseconds criticalPathTime{0};
+		// Tasks in the critical path, in execution order
+		std::vector<TaskId> criticalPath;
+
+		/**
+		 * How many threads the graph could keep busy on average, if there was no scheduling overhead.
+		 */
+		double getParallelism() const
+		{
+			return criticalPathTime.count() ? double(totalWork.count()) / double(criticalPathTime.count()) : 0;
+		}
+	};
+
+	TaskGraph() = default;
+	CZ_DELETE_COPY_AND_MOVE(TaskGraph);
+
+	/**
+	 * Adds a task.
+	 * `f` is called once per run, so it should not consume its state.
+	 */
+	TaskId add(std::string name, Command&& f);
+
+	/**
+	 * Makes `after` only run once `before` has finished.
+	 * Adding the same dependency more than once is allowed, but pointless.
+	 */
+	void precede(TaskId before, TaskId after);
+
+	/**
+	 * Makes `task` only run once all the specified tasks have finished.
+	 */
+	void succeed(TaskId task, std::initializer_list<TaskId> dependencies)
+	{
+		for (TaskId dependency : dependencies)
+		{
+			precede(dependency, task);
+		}
+	}
+
+	size_t size() const
+	{
+		return m_nodes.size();
+	}
+
+	const std::string& getName(TaskId task) const;
+
+	/**
+	 * Checks if the graph is valid (it has no cycles).
+	 * `run` fails if the graph has cycles, so this is mostly useful while building graphs from data.
+	 */
+	bool validate();
+
+	/**
+	 * Runs all the tasks in the pool (and the calling thread), and waits for them to finish.
+	 * Fails if the graph has cycles.
+	 *
+	 * The graph can't be changed or run by other threads while running, and the tasks can't run the graph they belong to.
+	 * Since this blocks, it should not be called from inside one of the pool's workers, which would have one less thread to run
+	 * the tasks.
+	 */
+	RunStats run(ThreadPool& pool);
+
+  private:
+
+	struct Node
+	{
+		std::string name;
+		Command f;
+		std::vector<TaskId> successors;
+		uint32_t numPredecessors = 0;
+		// Predecessors that didn't finish yet, in the current run
+		std::atomic<uint32_t> pending = 0;
+		// Time when the task started and finished in the current run, relative to the run's start. Only written by the thread
+		// executing the task, and read once the run is over
+		int64_t startNs = 0;
+		int64_t endNs = 0;
+	};
+
+	struct RunState;
+
+	/**
+	 * Calculates the execution order, which is used to detect cycles and calculate the critical path.
+	 * Returns false if there are cycles.
+	 */
+	bool prepare();
+
+	void schedule(const std::shared_ptr<RunState>& state, Node* node);
+	void execute(const std::shared_ptr<RunState>& state, Node* node);
+	void calcStats(RunStats& stats) const;
+
+	// Nodes don't move once added, since they are used concurrently while running
+	std::vector<std::unique_ptr<Node>> m_nodes;
+	// Tasks in a topological order. Only valid if m_dirty is false
+	std::vector<TaskId> m_order;
+	std::vector<Node*> m_roots;
+	bool m_dirty = true;
+	bool m_running = false;
+};
+
+} // namespace cz
@@ -0,0 +1,149 @@
+#include "ThreadPool.h"
+#include "PlatformUtils.h"
+#include "Logging.h"
+
+namespace cz
+{
+
+ThreadPool::ThreadPool(uint32_t numWorkers)
+{
+	if (numWorkers == 0)
+	{
+		numWorkers = std::max(getNumPhysicalCores(), 1u);
+	}
+
+	m_workers.reserve(numWorkers);
+	for (uint32_t i = 0; i < numWorkers; i++)
+	{
+		auto w = std::make_unique<Worker>();
+		w->outer = this;
+		w->index = i;
+		// Any non-zero seed will do for xorshift
+		w->rng = 0x9E3779B9u * (i + 1);
+		m_workers.push_back(std::move(w));
+	}
+
+	// Only start the threads once all the workers exist, since they'll look at each other's deques
+	for (auto& w : m_workers)
+	{
+		w->thread = std::thread(&ThreadPool::run, this, std::ref(*w));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	CZ_CHECK(!isWorkerThread());
+	m_finish.store(true);
+	m_idle.notifyAll();
+	for (auto& w : m_workers)
+	{
+		w->thread.join();
+	}
+}
+
+bool ThreadPool::isWorkerThread() const
+{
+	return ms_currentWorker && ms_currentWorker->outer == this;
+}
+
+void ThreadPool::send(Command&& f)
+{
+	CZ_CHECK(f);
+
+	if (isWorkerThread())
+	{
+		ms_currentWorker->deque.push(SlabPool<Task>::create(std::move(f)));
+	}
+	else
+	{
+		m_injection.push(std::move(f));
+	}
+
+	m_idle.notifyOne();
+}
+
+bool ThreadPool::findWork(Worker& w, Command& f)
+{
+	Task* task;
+	if (w.deque.pop(task))
+	{
+		f = std::move(task->f);
+		SlabPool<Task>::destroy(task);
+		return true;
+	}
+
+	if (m_injection.tryAndPop(f))
+	{
+		return true;
+	}
+
+	// xorshift32
+	w.rng ^= w.rng << 13;
+	w.rng ^= w.rng >> 17;
+	w.rng ^= w.rng << 5;
+
+	uint32_t numWorkers = getNumWorkers();
+	uint32_t start = w.rng % numWorkers;
+	for (uint32_t i = 0; i < numWorkers; i++)
+	{
+		Worker& victim = *m_workers[(start + i) % numWorkers];
+		if (&victim == &w)
+			continue;
+
+		if (victim.deque.steal(task))
+		{
+			f = std::move(task->f);
+			SlabPool<Task>::destroy(task);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::run(Worker& w)
+{
+	ms_currentWorker = &w;
+
+	Command f;
+	int spins = 0;
+	while (true)
+	{
+		if (findWork(w, f))
+		{
+			f();
+			f = nullptr;
+			spins = 0;
+			continue;
+		}
+
+		if (spins < SpinCount)
+		{
+			spins++;
+			emitPause();
+			continue;
+		}
+
+		// Nothing to do, so park until something is queued or we are shutting down.
+		// We only exit once there is nothing else to do, so that all commands get executed.
+		bool found = false;
+		m_idle.wait([&]()
+		{
+			found = findWork(w, f);
+			return found || m_finish.load();
+		});
+
+		if (!found)
+		{
+			break;
+		}
+
+		f();
+		f = nullptr;
+		spins = 0;
+	}
+
+	ms_currentWorker = nullptr;
+}
+
+} // namespace cz
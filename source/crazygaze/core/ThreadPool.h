@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Common.h"
+#include "SharedQueue.h"
+#include "SlabPool.h"
+#include "ThreadingUtils.h"
+#include "WorkStealingDeque.h"
+
+namespace cz
+{
+
+/**
+ * Work stealing thread pool.
+ *
+ * - Each worker has its own WorkStealingDeque. Commands sent from inside a worker go to that worker's deque, and the worker
+ *   pops them in LIFO order.
+ * - Commands sent from other threads go to a global injection queue (a WorkQueue).
+ * - Idle workers look in their own deque, then the injection queue, and then try to steal from other workers, starting with
+ *   a random victim.
+ * - Workers that can't find anything to do spin for a little bit, and then park, so idle workers don't burn CPU.
+ *
+ * There are no guarantees about the order in which commands are executed.
+ */
+class ThreadPool
+{
+  public:
+
+	/**
+	 * @param numWorkers Number of worker threads. If 0, it uses `getNumPhysicalCores()`
+	 */
+	explicit ThreadPool(uint32_t numWorkers = 0);
+
+	/**
+	 * Waits for all the queued commands to be executed, and then stops the workers.
+	 */
+	~ThreadPool();
+
+	CZ_DELETE_COPY_AND_MOVE(ThreadPool);
+
+	/**
+	 * Queues a command for execution on any of the workers. Can be called from any thread.
+	 */
+	void send(Command&& f);
+
+	uint32_t getNumWorkers() const
+	{
+		return static_cast<uint32_t>(m_workers.size());
+	}
+
+	/**
+	 * Returns true if the calling thread is one of this pool's workers
+	 */
+	bool isWorkerThread() const;
+
+  private:
+
+	// Commands sent from worker threads are wrapped in a Task so they fit in the deque. Tasks come from a SlabPool, since
+	// they are often destroyed by a different worker than the one that created them (when stolen).
+	struct Task
+	{
+		Command f;
+	};
+
+	struct Worker
+	{
+		ThreadPool* outer;
+		uint32_t index;
+		// State for the random number generator used to pick victims
+		uint32_t rng;
+		WorkStealingDeque<Task*> deque;
+		std::thread thread;
+	};
+
+	void run(Worker& w);
+
+	/**
+	 * Finds something for the worker to do, looking in the worker's deque, the injection queue, and then stealing from other
+	 * workers.
+	 */
+	bool findWork(Worker& w, Command& f);
+
+	// How many times a worker tries to find work before parking
+	static constexpr int SpinCount = 64;
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	WorkQueue m_injection;
+	EventCount m_idle;
+	std::atomic<bool> m_finish = false;
+
+	inline static thread_local Worker* ms_currentWorker = nullptr;
+};
+
+} // namespace cz
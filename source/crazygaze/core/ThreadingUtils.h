@@ -1,8 +1,42 @@
 #pragma once
 
+#include "Common.h"
+#include "Logging.h"
+
 namespace cz
 {
 
+/**
+ * Size of a cache line, used to pad data shared between threads so that unrelated atomics don't end up in the same cache line
+ * (false sharing).
+ *
+ * Not using std::hardware_destructive_interference_size, because compilers warn about its use in headers, since it can
+ * change depending on compiler flags.
+ */
+inline constexpr size_t CacheLineSize = 64;
+
+/**
+ * Hints the CPU that we are in a spin-wait loop.
+ * Copied from Tracy
+ */
+inline void emitPause()
+{
+#if defined(_MSC_VER) && !(defined(_M_ARM) || defined(_M_ARM64))
+	_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+	__asm__ volatile("pause" ::: "memory");
+#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+	__asm__ volatile("yield" ::: "memory");
+#elif defined(__powerpc__) || defined(__powerpc64__)
+		// No idea if ever been compiled in such archs but ... as precaution
+	__asm__ volatile("or 27,27,27");
+#elif defined(__sparc__)
+	__asm__ volatile("rd %ccr, %g0 \n\trd %ccr, %g0 \n\trd %ccr, %g0");
+#else
+	std::this_thread::yield();
+#endif
+}
+
 /*!
  * Based on Herb Sutters's Monitor<T> class.
  * It protects all access to an object
@@ -26,6 +60,42 @@ public:
 	}
 };
 
+/**
+ * Similar to Monitor, but for objects that are mostly read.
+ *
+ * `read` gives the visitor const access while holding a shared lock, so any number of readers can run at the same time.
+ * `write` gives the visitor mutable access while holding an exclusive lock.
+ *
+ * Readers still write to the mutex's cache line to take the shared lock. If the object is small and trivially copyable,
+ * SeqLock scales better.
+ */
+template <typename T, typename Mutex = std::shared_mutex>
+class SharedMonitor
+{
+  private:
+	T m_t;
+	mutable Mutex m_mtx;
+
+  public:
+	using Type = T;
+	SharedMonitor() {}
+	SharedMonitor(T t_) : m_t(std::move(t_)) {}
+
+	template <typename F>
+	auto read(F f) const -> decltype(f(m_t))
+	{
+		std::shared_lock<Mutex> hold{ m_mtx };
+		return f(m_t);
+	}
+
+	template <typename F>
+	auto write(F f) -> decltype(f(m_t))
+	{
+		std::lock_guard<Mutex> hold{ m_mtx };
+		return f(m_t);
+	}
+};
+
 /**
  * Copied from https://rigtorp.se/spinlock/
  *
@@ -33,39 +103,28 @@ public:
  * A spinlock mutex doesn't put the thread to sleep. Instead, it continuously checks if the lock is available. This is
  * faster if we know that the locks are held for very short periods.
  *
+ * If `ExponentialBackoff` is true, waiters back off for exponentially longer periods (up to a limit) every time they fail to
+ * grab the lock, which reduces the traffic on the lock's cache line when there are many waiters.
+ *
  * NOTE: Because this implements the same public interface as std::mutex, it can be used with
  * std::lock_guard and std::unique_lock.
  *
+ * NOTE: This is not fair. Under heavy contention, some threads can starve. See TicketSpinLock and MCSSpinLock.
  */
-class SpinLock
+template<bool ExponentialBackoff>
+class BasicSpinLock
 {
   private:
 
-	std::atomic<bool> lock_ = {0};
+	static constexpr uint32_t MaxBackoff = 1024;
 
-	// Copied from Tracy
-	void emitPause()
-	{
-	#if defined(_MSC_VER) && !(defined(_M_ARM) || defined(_M_ARM64))
-		_mm_pause();
-	#elif defined(__x86_64__) || defined(__i386__)
-		__asm__ volatile("pause" ::: "memory");
-	#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
-		__asm__ volatile("yield" ::: "memory");
-	#elif defined(__powerpc__) || defined(__powerpc64__)
-			// No idea if ever been compiled in such archs but ... as precaution
-		__asm__ volatile("or 27,27,27");
-	#elif defined(__sparc__)
-		__asm__ volatile("rd %ccr, %g0 \n\trd %ccr, %g0 \n\trd %ccr, %g0");
-	#else
-		std::this_thread::yield();
-	#endif
-	}
+	std::atomic<bool> lock_ = {0};
 
   public:
 
 	void lock() noexcept
 	{
+		uint32_t backoff = 1;
 		for (;;)
 		{
 			// Optimistically assume the lock is free on the first try
@@ -76,9 +135,20 @@ class SpinLock
 			// Wait for lock to be released without generating cache misses
 			while (lock_.load(std::memory_order_relaxed))
 			{
-				// Issue X86 PAUSE or ARM YIELD instruction to reduce contention between
-				// hyper-threads
-				emitPause();
+				if constexpr (ExponentialBackoff)
+				{
+					for (uint32_t i = 0; i < backoff; i++)
+					{
+						emitPause();
+					}
+					backoff = std::min(backoff * 2, MaxBackoff);
+				}
+				else
+				{
+					// Issue X86 PAUSE or ARM YIELD instruction to reduce contention between
+					// hyper-threads
+					emitPause();
+				}
 			}
 		}
 	}
@@ -96,6 +166,461 @@ class SpinLock
 	}
 };
 
+using SpinLock = BasicSpinLock<false>;
+using BackoffSpinLock = BasicSpinLock<true>;
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+namespace details
+{
+	/**
+	 * With fair locks, if the thread next in line gets preempted, everyone else waits for it. If there are more threads than
+	 * cores, that can take a whole scheduler time slice, so after spinning for a while we start yielding.
+	 */
+	inline void spinOrYield(uint32_t& spins)
+	{
+		constexpr uint32_t SpinsBeforeYield = 1024;
+		if (++spins >= SpinsBeforeYield)
+		{
+			std::this_thread::yield();
+		}
+	}
+} // namespace details
+
+/**
+ * Fair (FIFO) spinlock.
+ *
+ * Each thread takes a ticket and waits until its number is served, so threads get the lock in the order they asked for it.
+ * Waiters still spin on a shared cache line, but since they know how many threads are ahead of them, they pause proportionally
+ * to that, which keeps the traffic down.
+ *
+ * Same interface as std::mutex, so it can be used with std::lock_guard, std::unique_lock and Monitor.
+ */
+class TicketSpinLock
+{
+  public:
+	TicketSpinLock() = default;
+	CZ_DELETE_COPY_AND_MOVE(TicketSpinLock);
+
+	void lock() noexcept
+	{
+		const uint32_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+		uint32_t spins = 0;
+		for (;;)
+		{
+			const uint32_t serving = m_serving.load(std::memory_order_acquire);
+			if (serving == ticket)
+			{
+				return;
+			}
+
+			// Unsigned arithmetic, so it works fine when the counters wrap around
+			const uint32_t ahead = ticket - serving;
+			for (uint32_t i = 0; i < ahead * PausesPerWaiter; i++)
+			{
+				emitPause();
+			}
+			details::spinOrYield(spins);
+		}
+	}
+
+	bool try_lock() noexcept
+	{
+		uint32_t serving = m_serving.load(std::memory_order_relaxed);
+		return m_next.compare_exchange_strong(serving, serving + 1, std::memory_order_acquire, std::memory_order_relaxed);
+	}
+
+	void unlock() noexcept
+	{
+		// Only the owner writes to m_serving, so a plain load+store is enough
+		m_serving.store(m_serving.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+  private:
+
+	static constexpr uint32_t PausesPerWaiter = 16;
+
+	// Kept in separate cache lines, so that threads taking tickets don't disturb the threads waiting for their turn
+	alignas(CacheLineSize) std::atomic<uint32_t> m_next = 0;
+	alignas(CacheLineSize) std::atomic<uint32_t> m_serving = 0;
+};
+
+/**
+ * MCS queue lock (Mellor-Crummey and Scott).
+ *
+ * Waiters form a linked list, and each waiter spins on a flag in its own node (each in its own cache line), so a release only
+ * touches the cache line of the next thread in line. This makes it fair (FIFO) and it scales well with the number of waiting
+ * threads.
+ *
+ * Unlike the classic MCS lock, the caller doesn't need to provide the queue node, so this has the same interface as std::mutex
+ * and can be used with std::lock_guard, std::unique_lock and Monitor. The nodes come from a small per thread pool, which limits
+ * how many MCSSpinLock a single thread can hold at the same time (see MaxHeldLocks).
+ *
+ * As with std::mutex, the lock must be released by the same thread that acquired it.
+ */
+class MCSSpinLock
+{
+  public:
+	/**
+	 * How many MCSSpinLock a thread can hold at the same time
+	 */
+	static constexpr size_t MaxHeldLocks = 8;
+
+	MCSSpinLock() = default;
+	CZ_DELETE_COPY_AND_MOVE(MCSSpinLock);
+
+	void lock() noexcept
+	{
+		Node* node = acquireNode();
+		Node* prev = m_tail.exchange(node, std::memory_order_acq_rel);
+		if (prev)
+		{
+			// Enqueue ourselves and wait for our predecessor to hand over the lock
+			prev->next.store(node, std::memory_order_release);
+			uint32_t spins = 0;
+			while (node->locked.load(std::memory_order_acquire))
+			{
+				emitPause();
+				details::spinOrYield(spins);
+			}
+		}
+		m_owner = node;
+	}
+
+	bool try_lock() noexcept
+	{
+		if (m_tail.load(std::memory_order_relaxed))
+		{
+			return false;
+		}
+
+		Node* node = acquireNode();
+		Node* expected = nullptr;
+		if (m_tail.compare_exchange_strong(expected, node, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			m_owner = node;
+			return true;
+		}
+
+		releaseNode(node);
+		return false;
+	}
+
+	void unlock() noexcept
+	{
+		Node* node = m_owner;
+		Node* next = node->next.load(std::memory_order_acquire);
+		if (!next)
+		{
+			// If nobody is queued behind us, we can just clear the tail
+			Node* expected = node;
+			if (m_tail.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel, std::memory_order_relaxed))
+			{
+				releaseNode(node);
+				return;
+			}
+
+			// Someone swapped the tail, but didn't link to us yet
+			while (!(next = node->next.load(std::memory_order_acquire)))
+			{
+				emitPause();
+			}
+		}
+
+		// After this, the next thread owns the lock and no one else touches our node
+		next->locked.store(false, std::memory_order_release);
+		releaseNode(node);
+	}
+
+  private:
+
+	struct alignas(CacheLineSize) Node
+	{
+		std::atomic<Node*> next;
+		std::atomic<bool> locked;
+		Node* nextFree;
+	};
+
+	struct NodePool
+	{
+		NodePool()
+		{
+			for (size_t i = 0; i < MaxHeldLocks; i++)
+			{
+				nodes[i].nextFree = free;
+				free = &nodes[i];
+			}
+		}
+
+		Node nodes[MaxHeldLocks];
+		Node* free = nullptr;
+	};
+
+	static Node* acquireNode() noexcept
+	{
+		NodePool& pool = ms_pool;
+		Node* node = pool.free;
+		// If this fails, the thread is holding more than MaxHeldLocks locks
+		CZ_CHECK(node);
+		pool.free = node->nextFree;
+		node->next.store(nullptr, std::memory_order_relaxed);
+		node->locked.store(true, std::memory_order_relaxed);
+		return node;
+	}
+
+	static void releaseNode(Node* node) noexcept
+	{
+		NodePool& pool = ms_pool;
+		node->nextFree = pool.free;
+		pool.free = node;
+	}
+
+	static inline thread_local NodePool ms_pool;
+
+	std::atomic<Node*> m_tail = nullptr;
+	// Node used by the thread currently holding the lock. Only accessed by the owner.
+	Node* m_owner = nullptr;
+};
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+/**
+ * Sequence lock, for small trivially copyable objects that are read often and written rarely.
+ *
+ * Readers don't write to any shared memory. They copy the object and retry if a writer changed it in the meantime (detected
+ * with a sequence number that is odd while a write is in progress). This means reads scale with the number of cores, but
+ * writers can starve readers if they write continuously.
+ *
+ * Writers are serialized with each other through the sequence number itself.
+ *
+ * The object is stored as an array of relaxed atomic words, so that concurrent reads and writes are not a data race.
+ */
+template<typename T>
+class alignas(CacheLineSize) SeqLock
+{
+	static_assert(std::is_trivially_copyable_v<T>, "SeqLock requires a trivially copyable type");
+
+  public:
+	SeqLock() : SeqLock(T{})
+	{
+	}
+
+	explicit SeqLock(const T& value)
+	{
+		storeWords(value);
+	}
+
+	CZ_DELETE_COPY_AND_MOVE(SeqLock);
+
+	/**
+	 * Returns a consistent copy of the object.
+	 */
+	T load() const
+	{
+		uint64_t words[NumWords];
+		for (;;)
+		{
+			const uint32_t seq = m_seq.load(std::memory_order_acquire);
+			if (seq & 1)
+			{
+				// A write is in progress
+				emitPause();
+				continue;
+			}
+
+			for (size_t i = 0; i < NumWords; i++)
+			{
+				words[i] = m_words[i].load(std::memory_order_relaxed);
+			}
+
+			// Makes sure the loads above happen before checking the sequence number again
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_seq.load(std::memory_order_relaxed) == seq)
+			{
+				break;
+			}
+		}
+
+		T res;
+		memcpy(&res, words, sizeof(T));
+		return res;
+	}
+
+	void store(const T& value)
+	{
+		const uint32_t seq = beginWrite();
+		storeWords(value);
+		endWrite(seq);
+	}
+
+	/**
+	 * Calls `f` with a copy of the current object for it to change, and stores the result, all while blocking other writers.
+	 */
+	template<typename F>
+	void update(F f)
+	{
+		const uint32_t seq = beginWrite();
+		// No other writers, so the current value can be read without checking the sequence number
+		uint64_t words[NumWords];
+		for (size_t i = 0; i < NumWords; i++)
+		{
+			words[i] = m_words[i].load(std::memory_order_relaxed);
+		}
+		T value;
+		memcpy(&value, words, sizeof(T));
+
+		f(value);
+		storeWords(value);
+		endWrite(seq);
+	}
+
+  private:
+
+	static constexpr size_t NumWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	uint32_t beginWrite()
+	{
+		uint32_t seq = m_seq.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			if (!(seq & 1) &&
+				m_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				break;
+			}
+			emitPause();
+			seq = m_seq.load(std::memory_order_relaxed);
+		}
+
+		// Makes sure readers see the odd sequence number before any of the changes to the object
+		std::atomic_thread_fence(std::memory_order_release);
+		return seq + 1;
+	}
+
+	void endWrite(uint32_t seq)
+	{
+		m_seq.store(seq + 1, std::memory_order_release);
+	}
+
+	void storeWords(const T& value)
+	{
+		uint64_t words[NumWords] = {};
+		memcpy(words, &value, sizeof(T));
+		for (size_t i = 0; i < NumWords; i++)
+		{
+			m_words[i].store(words[i], std::memory_order_relaxed);
+		}
+	}
+
+	std::atomic<uint32_t> m_seq = 0;
+	std::atomic<uint64_t> m_words[NumWords];
+};
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
+
+/**
+ * Lets lock-free data structures block consumers without paying for a mutex/condition variable in the fast path.
+ *
+ * The producer makes the condition true (e.g: pushes an item) and then calls `notifyOne`/`notifyAll`. Those only touch the
+ * mutex and condition variable if there are threads blocked in `wait`/`waitFor`/`waitUntil`.
+ *
+ * The consumer passes a predicate that is evaluated with the internal mutex held, and it only blocks while the predicate
+ * returns false. The predicate can have side effects (e.g: try to pop an item), as long as it returns true when it succeeds.
+ */
+class EventCount
+{
+  public:
+	EventCount() = default;
+	CZ_DELETE_COPY_AND_MOVE(EventCount);
+
+	void notifyOne()
+	{
+		// Pairs with the fence in `prepareWait`. Either we see the waiter, or the waiter sees whatever we did before calling
+		// this.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiters.load(std::memory_order_relaxed) == 0)
+			return;
+
+		// Taking the lock guarantees the waiter is either not yet evaluating the predicate, or is already blocked
+		{
+			std::lock_guard lk(m_mtx);
+		}
+		m_cv.notify_one();
+	}
+
+	void notifyAll()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiters.load(std::memory_order_relaxed) == 0)
+			return;
+
+		{
+			std::lock_guard lk(m_mtx);
+		}
+		m_cv.notify_all();
+	}
+
+	/**
+	 * Blocks until `pred` returns true
+	 */
+	template<typename Pred>
+	void wait(Pred&& pred)
+	{
+		std::unique_lock lk(m_mtx);
+		prepareWait();
+		m_cv.wait(lk, std::forward<Pred>(pred));
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Blocks until `pred` returns true or the timeout point is reached.
+	 * @return The last value returned by `pred`
+	 */
+	template<typename Clock, typename Duration, typename Pred>
+	bool waitUntil(const std::chrono::time_point<Clock, Duration>& point, Pred&& pred)
+	{
+		std::unique_lock lk(m_mtx);
+		prepareWait();
+		bool res = m_cv.wait_until(lk, point, std::forward<Pred>(pred));
+		m_waiters.fetch_sub(1, std::memory_order_relaxed);
+		return res;
+	}
+
+	/**
+	 * Blocks until `pred` returns true or the timeout expires.
+	 * @return The last value returned by `pred`
+	 */
+	template<typename Rep, typename Period, typename Pred>
+	bool waitFor(const std::chrono::duration<Rep, Period>& timeout, Pred&& pred)
+	{
+		return waitUntil(std::chrono::steady_clock::now() + timeout, std::forward<Pred>(pred));
+	}
+
+  private:
+
+	void prepareWait()
+	{
+		m_waiters.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	std::atomic<uint32_t> m_waiters = 0;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+};
+
 
 /**
  * Callstack marker, based on my own article at:
@@ -0,0 +1,329 @@
+#include "TimerWheel.h"
+#include "Logging.h"
+
+namespace cz
+{
+
+TimerWheel::TimerWheel(Clock::time_point start)
+	: m_start(start)
+{
+}
+
+uint64_t TimerWheel::toTicks(Clock::time_point tp) const
+{
+	if (tp <= m_start)
+		return 0;
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(tp - m_start).count());
+}
+
+TimerWheel::Clock::time_point TimerWheel::fromTicks(uint64_t ticks) const
+{
+	return m_start + std::chrono::milliseconds(ticks);
+}
+
+uint32_t TimerWheel::allocNode()
+{
+	uint32_t index;
+	if (m_freeHead != Null)
+	{
+		index = m_freeHead;
+		m_freeHead = m_nodes[index].next;
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_nodes.size());
+		m_nodes.emplace_back();
+	}
+
+	Node& node = m_nodes[index];
+	node.prev = Null;
+	node.next = Null;
+	m_numTimers++;
+	return index;
+}
+
+void TimerWheel::freeNode(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	node.cmd = nullptr;
+	node.state = State::Free;
+	// Invalidates any TimerId pointing to this node
+	node.generation++;
+	node.next = m_freeHead;
+	m_freeHead = index;
+	m_numTimers--;
+}
+
+TimerId TimerWheel::makeId(uint32_t index) const
+{
+	return TimerId{(uint64_t(m_nodes[index].generation) << 32) | index};
+}
+
+TimerWheel::Node* TimerWheel::getNode(TimerId id)
+{
+	const uint32_t index = static_cast<uint32_t>(id.value);
+	if (!id || index >= m_nodes.size())
+		return nullptr;
+
+	Node& node = m_nodes[index];
+	if (node.generation != static_cast<uint32_t>(id.value >> 32) || node.state == State::Free)
+		return nullptr;
+
+	return &node;
+}
+
+void TimerWheel::pushBack(List& list, uint32_t index)
+{
+	Node& node = m_nodes[index];
+	node.prev = list.tail;
+	node.next = Null;
+	if (list.tail != Null)
+		m_nodes[list.tail].next = index;
+	else
+		list.head = index;
+	list.tail = index;
+}
+
+void TimerWheel::unlink(List& list, uint32_t index)
+{
+	Node& node = m_nodes[index];
+	if (node.prev != Null)
+		m_nodes[node.prev].next = node.next;
+	else
+		list.head = node.next;
+
+	if (node.next != Null)
+		m_nodes[node.next].prev = node.prev;
+	else
+		list.tail = node.prev;
+
+	node.prev = Null;
+	node.next = Null;
+}
+
+void TimerWheel::insert(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	CZ_CHECK(node.deadline >= m_now);
+	const uint64_t delta = node.deadline - m_now;
+
+	// Find the lowest level that can hold the timer. Level L covers deltas up to NumSlots^(L+1)
+	int level = 0;
+	while (level < NumLevels - 1 && delta >= (uint64_t(1) << (SlotBits * (level + 1))))
+	{
+		level++;
+	}
+
+	uint32_t slot;
+	if (delta >= (uint64_t(1) << (SlotBits * NumLevels)))
+	{
+		// Too far in the future, so put it in the furthest slot. It will be put back in the top level when cascaded.
+		slot = static_cast<uint32_t>((m_now >> (SlotBits * level)) + SlotMask) & SlotMask;
+	}
+	else
+	{
+		slot = static_cast<uint32_t>(node.deadline >> (SlotBits * level)) & SlotMask;
+	}
+
+	node.state = State::Pending;
+	node.level = static_cast<uint8_t>(level);
+	node.slot = static_cast<uint8_t>(slot);
+	pushBack(m_slots[level][slot], index);
+	m_occupied[level] |= uint64_t(1) << slot;
+	m_numPending++;
+}
+
+void TimerWheel::remove(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	List& list = m_slots[node.level][node.slot];
+	unlink(list, index);
+	if (list.head == Null)
+		m_occupied[node.level] &= ~(uint64_t(1) << node.slot);
+	m_numPending--;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot)
+{
+	List list = m_slots[level][slot];
+	m_slots[level][slot] = List{};
+	m_occupied[level] &= ~(uint64_t(1) << slot);
+
+	uint32_t index = list.head;
+	while (index != Null)
+	{
+		const uint32_t next = m_nodes[index].next;
+		m_numPending--;
+		insert(index);
+		index = next;
+	}
+}
+
+TimerId TimerWheel::add(Clock::time_point deadline, Clock::duration period, Command&& cmd)
+{
+	CZ_CHECK(cmd);
+	CZ_CHECK(period.count() >= 0);
+
+	const uint32_t index = allocNode();
+	Node& node = m_nodes[index];
+	node.cmd = std::move(cmd);
+
+	// Rounding up, so the timer never executes early
+	auto ms = std::chrono::ceil<std::chrono::milliseconds>(deadline - m_start).count();
+	node.deadline = std::max(static_cast<uint64_t>(std::max<int64_t>(ms, 0)), m_now + 1);
+	node.period = 0;
+	if (period.count())
+	{
+		node.period = std::max<uint64_t>(1, std::chrono::ceil<std::chrono::milliseconds>(period).count());
+	}
+
+	insert(index);
+	return makeId(index);
+}
+
+bool TimerWheel::cancel(TimerId id)
+{
+	Node* node = getNode(id);
+	if (!node)
+		return false;
+
+	const uint32_t index = static_cast<uint32_t>(id.value);
+	switch (node->state)
+	{
+		case State::Pending:
+			remove(index);
+			freeNode(index);
+			return true;
+		case State::Due:
+			unlink(m_due, index);
+			m_numDue--;
+			freeNode(index);
+			return true;
+		case State::Running:
+			// The command was moved out by `popDue`, so `finish` takes care of removing it
+			node->state = State::RunningCancelled;
+			return false;
+		default:
+			return false;
+	}
+}
+
+uint64_t TimerWheel::calcNextEventTick() const
+{
+	CZ_CHECK(m_numPending);
+	uint64_t res = UINT64_MAX;
+	for (int level = 0; level < NumLevels; level++)
+	{
+		if (m_occupied[level] == 0)
+			continue;
+
+		// Slot `current+1` is the next one to be processed at this level, and `current` is the last one (next rotation)
+		const int shift = SlotBits * level;
+		const uint64_t current = m_now >> shift;
+		const uint32_t rot = static_cast<uint32_t>((current + 1) & SlotMask);
+		const int k = std::countr_zero(std::rotr(m_occupied[level], static_cast<int>(rot)));
+		res = std::min(res, (current + 1 + k) << shift);
+	}
+	return res;
+}
+
+size_t TimerWheel::collect(Clock::time_point now)
+{
+	const uint64_t target = toTicks(now);
+	while (m_now < target)
+	{
+		if (m_numPending == 0)
+		{
+			m_now = target;
+			break;
+		}
+
+		// Skip ahead to the next tick where there is something to do
+		const uint64_t next = calcNextEventTick();
+		if (next > target)
+		{
+			m_now = target;
+			break;
+		}
+		m_now = next;
+
+		// Cascade from the highest level down, since timers from a higher level can end up in a lower level slot that is also
+		// being cascaded right now
+		int level = 1;
+		while (level < NumLevels && (m_now & ((uint64_t(1) << (SlotBits * level)) - 1)) == 0)
+		{
+			level++;
+		}
+		while (--level > 0)
+		{
+			cascade(level, static_cast<uint32_t>(m_now >> (SlotBits * level)) & SlotMask);
+		}
+
+		// Anything left in the level 0 slot is due now
+		const uint32_t slot = static_cast<uint32_t>(m_now & SlotMask);
+		List& list = m_slots[0][slot];
+		uint32_t index = list.head;
+		while (index != Null)
+		{
+			const uint32_t nextIndex = m_nodes[index].next;
+			m_nodes[index].state = State::Due;
+			pushBack(m_due, index);
+			m_numPending--;
+			m_numDue++;
+			index = nextIndex;
+		}
+		list = List{};
+		m_occupied[0] &= ~(uint64_t(1) << slot);
+	}
+
+	return m_numDue;
+}
+
+bool TimerWheel::popDue(TimerId& id, Command& cmd)
+{
+	const uint32_t index = m_due.head;
+	if (index == Null)
+		return false;
+
+	unlink(m_due, index);
+	m_numDue--;
+	Node& node = m_nodes[index];
+	node.state = State::Running;
+	id = makeId(index);
+	cmd = std::move(node.cmd);
+	return true;
+}
+
+void TimerWheel::finish(TimerId id, Command&& cmd)
+{
+	Node* node = getNode(id);
+	CZ_CHECK(node && (node->state == State::Running || node->state == State::RunningCancelled));
+
+	const uint32_t index = static_cast<uint32_t>(id.value);
+	if (node->period == 0 || node->state == State::RunningCancelled)
+	{
+		freeNode(index);
+		return;
+	}
+
+	// Keep the original schedule, so periodic timers don't drift, but if we fell behind, skip the executions we missed
+	// instead of executing them all in a burst.
+	node->cmd = std::move(cmd);
+	node->deadline += node->period;
+	if (node->deadline <= m_now)
+	{
+		node->deadline += ((m_now - node->deadline) / node->period + 1) * node->period;
+	}
+	insert(index);
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::getNextWakeUp() const
+{
+	if (m_due.head != Null)
+		return fromTicks(m_now);
+	if (m_numPending == 0)
+		return std::nullopt;
+	return fromTicks(calcNextEventTick());
+}
+
+} // namespace cz
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Common.h"
+#include "Command.h"
+
+namespace cz
+{
+
+/**
+ * Identifies a timer in a TimerWheel, so it can be cancelled.
+ */
+struct TimerId
+{
+	uint64_t value = 0;
+
+	explicit operator bool() const
+	{
+		return value != 0;
+	}
+
+	bool operator==(const TimerId&) const = default;
+};
+
+/**
+ * Hierarchical timer wheel (as described by Varghese & Lauck), with 1ms resolution.
+ *
+ * There are `NumLevels` wheels of `NumSlots` slots each. Slots at level 0 are 1ms wide, slots at level 1 are 64ms wide, and so
+ * on, which covers about 2 years. Timers are put in the slot that matches their deadline, at the lowest level that can hold
+ * them, and as time moves forward, timers in higher levels are moved (cascaded) down to lower levels.
+ * This makes adding and cancelling a timer O(1), no matter how many timers there are.
+ *
+ * Timers are never executed early, but can be up to 1ms late (on top of however late `collect` is called).
+ *
+ * This class is not thread safe. See AsyncCommandQueue::sendAfter/sendAt/sendEvery for a thread safe interface.
+ *
+ * Expired timers are not executed directly. Instead, `collect` moves them to a "due" list, and the caller pops them one at a
+ * time with `popDue`, executes them, and then gives them back with `finish`. This allows the caller to execute the commands
+ * without holding any locks, and lets commands add or cancel timers (including their own).
+ */
+class TimerWheel
+{
+  public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit TimerWheel(Clock::time_point start = Clock::now());
+	CZ_DELETE_COPY_AND_MOVE(TimerWheel);
+
+	/**
+	 * Adds a timer
+	 * @param deadline When to execute the command
+	 * @param period If not zero, the timer is periodic, and executes every `period` after the `deadline`
+	 */
+	TimerId add(Clock::time_point deadline, Clock::duration period, Command&& cmd);
+
+	/**
+	 * Cancels a timer.
+	 * @return True if the timer was cancelled before its command was executed. False if the timer doesn't exist anymore (it
+	 * was a one-shot timer that already executed, or it was already cancelled), or if the command is being executed right now.
+	 * Periodic timers that are being executed when cancelled are still removed once the command finishes.
+	 */
+	bool cancel(TimerId id);
+
+	/**
+	 * Moves all timers that expired by `now` to the due list.
+	 * @return Number of timers in the due list. This doesn't include timers popped with `popDue` that are still executing.
+	 */
+	size_t collect(Clock::time_point now);
+
+	/**
+	 * Pops the next timer from the due list, if any.
+	 * Once the caller executes the command, it must give it back with `finish`.
+	 */
+	bool popDue(TimerId& id, Command& cmd);
+
+	/**
+	 * Called once a command popped with `popDue` was executed.
+	 * Periodic timers are rescheduled (unless cancelled in the meantime), and one-shot timers are removed.
+	 */
+	void finish(TimerId id, Command&& cmd);
+
+	/**
+	 * Returns the earliest point in time `collect` needs to be called, or std::nullopt if there are no timers.
+	 * This might be earlier than the next deadline, since timers in higher levels need to be cascaded down.
+	 */
+	std::optional<Clock::time_point> getNextWakeUp() const;
+
+	/**
+	 * Number of timers, including the ones in the due list
+	 */
+	size_t size() const
+	{
+		return m_numTimers;
+	}
+
+  private:
+
+	static constexpr int SlotBits = 6;
+	static constexpr uint32_t NumSlots = 1 << SlotBits;
+	static constexpr uint32_t SlotMask = NumSlots - 1;
+	static constexpr int NumLevels = 6;
+	static constexpr uint32_t Null = ~uint32_t(0);
+
+	enum class State : uint8_t
+	{
+		Free,
+		Pending,
+		Due,
+		Running,
+		RunningCancelled
+	};
+
+	struct Node
+	{
+		Command cmd;
+		// Deadline and period in ticks
+		uint64_t deadline = 0;
+		uint64_t period = 0;
+		uint32_t prev = Null;
+		uint32_t next = Null;
+		uint32_t generation = 1;
+		State state = State::Free;
+		uint8_t level = 0;
+		uint8_t slot = 0;
+	};
+
+	struct List
+	{
+		uint32_t head = Null;
+		uint32_t tail = Null;
+	};
+
+	uint64_t toTicks(Clock::time_point tp) const;
+	Clock::time_point fromTicks(uint64_t ticks) const;
+
+	uint32_t allocNode();
+	void freeNode(uint32_t index);
+	Node* getNode(TimerId id);
+	TimerId makeId(uint32_t index) const;
+
+	void pushBack(List& list, uint32_t index);
+	void unlink(List& list, uint32_t index);
+
+	// Puts a pending timer in the right slot for its deadline
+	void insert(uint32_t index);
+	// Removes a pending timer from its slot
+	void remove(uint32_t index);
+	// Moves all the timers in a slot to lower levels
+	void cascade(int level, uint32_t slot);
+	// Earliest tick (after m_now) when there is something to do. Only valid if there are pending timers
+	uint64_t calcNextEventTick() const;
+
+	Clock::time_point m_start;
+	// Current time, in ticks since m_start
+	uint64_t m_now = 0;
+	std::vector<Node> m_nodes;
+	uint32_t m_freeHead = Null;
+	size_t m_numTimers = 0;
+	// Number of timers in the wheel (not counting the due list)
+	size_t m_numPending = 0;
+	// Number of timers in the due list
+	size_t m_numDue = 0;
+	List m_slots[NumLevels][NumSlots];
+	// A bit per slot, set if the slot has timers
+	uint64_t m_occupied[NumLevels] = {};
+	List m_due;
+};
+
+} // namespace cz
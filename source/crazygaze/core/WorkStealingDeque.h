@@ -0,0 +1,179 @@
+#pragma once
+
+#include "Common.h"
+#include "Math.h"
+#include "ThreadingUtils.h"
+
+#if defined(_MSVC_LANG)
+__pragma(warning(push))
+__pragma(warning(disable: 4324))  /* 'structname': structure was padded due to alignment specifier */
+#endif
+
+namespace cz
+{
+
+/**
+ * Chase-Lev work stealing deque.
+ *
+ * Implemented as described in "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê, Pop, Cohen, Zappa Nardelli):
+ * https://fzn.fr/readings/ppopp13.pdf
+ *
+ * - The owner thread pushes and pops at the bottom (LIFO), which is good for cache locality.
+ * - Any other thread can steal from the top (FIFO).
+ * - It grows as required. Old arrays are kept around until the deque is destroyed, since a thief might still be reading from
+ *   them. Since the capacity doubles every time, that wastes at most as much memory as the current array.
+ *
+ * T needs to be something that fits in an atomic without locks (e.g: a pointer)
+ */
+template<typename T>
+class WorkStealingDeque
+{
+	static_assert(std::is_trivially_copyable_v<T> && std::atomic<T>::is_always_lock_free);
+
+  public:
+
+	explicit WorkStealingDeque(size_t initialCapacity = 256)
+	{
+		m_arrays.push_back(std::make_unique<Array>(round_pow2(std::max(initialCapacity, size_t(2)))));
+		m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+	}
+
+	CZ_DELETE_COPY_AND_MOVE(WorkStealingDeque);
+
+	/**
+	 * Pushes an item to the bottom. Can only be called by the owner thread.
+	 */
+	void push(T item)
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		int64_t t = m_top.load(std::memory_order_acquire);
+		Array* a = m_array.load(std::memory_order_relaxed);
+		if (b - t > static_cast<int64_t>(a->mask))
+		{
+			a = grow(a, t, b);
+		}
+
+		a->put(b, item);
+		m_bottom.store(b + 1, std::memory_order_release);
+	}
+
+	/**
+	 * Pops an item from the bottom. Can only be called by the owner thread.
+	 * @return true if an item was popped
+	 */
+	bool pop(T& item)
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+		Array* a = m_array.load(std::memory_order_relaxed);
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			// Empty
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = a->get(b);
+		if (t == b)
+		{
+			// Last item, so we race against thieves
+			bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Steals an item from the top. Can be called from any thread.
+	 * @return true if an item was stolen. Note that false doesn't mean the deque is empty, since it might have lost a race
+	 * against another thief or the owner.
+	 */
+	bool steal(T& item)
+	{
+		int64_t t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = m_bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return false;
+
+		Array* a = m_array.load(std::memory_order_acquire);
+		T tmp = a->get(t);
+		if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return false;
+
+		item = tmp;
+		return true;
+	}
+
+	/**
+	 * Approximate number of items
+	 */
+	size_t size() const
+	{
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+		return b > t ? static_cast<size_t>(b - t) : 0;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+  private:
+
+	struct Array
+	{
+		explicit Array(size_t capacity)
+			: mask(capacity - 1)
+			, data(std::make_unique<std::atomic<T>[]>(capacity))
+		{
+		}
+
+		T get(int64_t i) const
+		{
+			return data[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+		}
+
+		void put(int64_t i, T item)
+		{
+			data[static_cast<size_t>(i) & mask].store(item, std::memory_order_relaxed);
+		}
+
+		size_t mask;
+		std::unique_ptr<std::atomic<T>[]> data;
+	};
+
+	Array* grow(Array* a, int64_t t, int64_t b)
+	{
+		auto newArray = std::make_unique<Array>((a->mask + 1) * 2);
+		for (int64_t i = t; i < b; i++)
+		{
+			newArray->put(i, a->get(i));
+		}
+
+		Array* res = newArray.get();
+		m_arrays.push_back(std::move(newArray));
+		m_array.store(res, std::memory_order_release);
+		return res;
+	}
+
+	alignas(CacheLineSize) std::atomic<int64_t> m_top = 0;
+	alignas(CacheLineSize) std::atomic<int64_t> m_bottom = 0;
+	std::atomic<Array*> m_array;
+
+	// All the arrays ever created. Only touched by the owner
+	std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+} // namespace cz
+
+#if defined(_MSVC_LANG)
+__pragma(warning(pop))
+#endif
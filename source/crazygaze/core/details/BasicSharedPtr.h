@@ -245,6 +245,24 @@ class BasicSharedPtr
 		return res;
 	}
 
+	// Don't use this directly. It's for internal use only
+	ControlBlock* _internal_peekBlock() const noexcept
+	{
+		return m_control.ctrl;
+	}
+
+	// Don't use this directly. It's for internal use only
+	// Detaches from the control block without releasing the reference, and returns the control block.
+	ControlBlock* _internal_detachBlock() noexcept
+	{
+		ControlBlock* ctrl = m_control.ctrl;
+		m_control.ctrl = nullptr;
+		#if CZ_SHAREDPTR_STACKTRACES
+		m_control.trace = nullptr;
+		#endif
+		return ctrl;
+	}
+
 	// Don't use this directly. It's for internal use only
 	template<typename U>
 	static BasicSharedPtr _internal_stealBlockAndCreate(BasicSharedPtr<U, MT>& from)
@@ -479,9 +497,36 @@ class BasicWeakPtr
 		return {};
 #endif
 	}
+
+	// Don't use this directly. It's for internal use only
+	static BasicWeakPtr _internal_createFromAlreadyAcquiredBlock(ControlBlock* control) noexcept
+	{
+		BasicWeakPtr res;
+		res.acquireBlock<false>(control);
+		return res;
+	}
+
+	// Don't use this directly. It's for internal use only
+	ControlBlock* _internal_peekBlock() const noexcept
+	{
+		return m_control.ctrl;
+	}
+
+	// Don't use this directly. It's for internal use only
+	// Detaches from the control block without releasing the reference, and returns the control block.
+	ControlBlock* _internal_detachBlock() noexcept
+	{
+		ControlBlock* ctrl = m_control.ctrl;
+		m_control.ctrl = nullptr;
+		#if CZ_SHAREDPTR_STACKTRACES
+		m_control.trace = nullptr;
+		#endif
+		return ctrl;
+	}
+
   private:
 
-	template<typename U>
+	template<bool doInc = true, typename U>
 	void acquireBlock(details::SharedPtrControlBlock<U, MT>* control) noexcept
 	{
 		static_assert(std::is_convertible_v<U*,T*>);
@@ -491,7 +536,8 @@ class BasicWeakPtr
 #endif
 		if (m_control.ctrl)
 		{
-			m_control.ctrl->incWeak();
+			if constexpr(doInc)
+				m_control.ctrl->incWeak();
 #if CZ_SHAREDPTR_STACKTRACES
 			m_control.trace = m_control.ctrl->createStackTrace(details::SharedPtrTrace::Type::WeakRef);
 #endif
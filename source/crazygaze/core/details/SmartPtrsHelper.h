@@ -213,6 +213,10 @@ namespace details
 	 * bool dec_if_one()
 	 *		Decrements the value if the current value is one and returns true.
 	 *		If the current value is not one, it does nothing and returns false.
+	 * void add(uint32_t n)
+	 *		Increments the value by n
+	 * uint32_t sub(uint32_t n)
+	 *		Decrements the value by n and returns the new value
 	 */
 	template<bool ThreadSafe>
 	class RefCounter
@@ -281,6 +285,17 @@ namespace details
 				return false;
 			}
 		}
+
+		void add(uint32_t n) noexcept
+		{
+			m_value._Storage._Value += n;
+		}
+
+		[[nodiscard]] uint32_t sub(uint32_t n) noexcept
+		{
+			assert(m_value._Storage._Value >= n);
+			return m_value._Storage._Value -= n;
+		}
 	};
 
 	/**
@@ -356,6 +371,16 @@ namespace details
 			}
 			return false;
 		}
+
+		void add(uint32_t n) noexcept
+		{
+			m_value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		[[nodiscard]] uint32_t sub(uint32_t n) noexcept
+		{
+			return m_value.fetch_sub(n, std::memory_order_acq_rel) - n;
+		}
 	};
 
 
@@ -563,6 +588,40 @@ namespace details
 			}
 		}
 
+		/**
+		 * Adds/removes several references in one go.
+		 * This is used by AtomicSharedPtr/AtomicWeakPtr, which hold a batch of references that are handed out to readers.
+		 */
+		void addStrong(uint32_t n) noexcept
+		{
+			this->strong.add(n);
+		}
+
+		void addWeak(uint32_t n) noexcept
+		{
+			this->weak.add(n);
+		}
+
+		void subStrong(uint32_t n)
+		{
+			assert(this->strong.count() >= n);
+
+			if (this->strong.sub(n) == 0)
+			{
+				this->deleteObj();
+				decWeak();
+			}
+		}
+
+		void subWeak(uint32_t n)
+		{
+			if (this->weak.sub(n) == 0)
+			{
+				this->~SharedPtrControlBlock();
+				free(this);
+			}
+		}
+
 		void decWeak()
 		{
 			if (this->weak.dec() == 0)